@@ -11,7 +11,7 @@
 void GlobalExceptionHandling(const char *functionName, std::exception &e) {
     cclPrintf("Exception in %s: %s", functionName, e.what());
 //    关闭线程池
-    ThreadPool::getInstance()->~ThreadPool();
+    ThreadPool::getInstance()->shutdown();
 //    将数据库的名字改为备份
     rename("CaplUtil.db", "CaplUtil.db.bak");
     gVIAService->Stop();
@@ -16,33 +16,48 @@ void OnMeasurementPreStart() {
     cclPrintf("OnMeasurementPreStart");
 //    开启定时器
     globalVar.timerID = cclTimerCreate(&OnTimer);
+    TimerScheduler::getInstance()->init(globalVar.timerID);
+    DiagCompletion::getInstance()->resolve();
     globalVar.VIAChannel = gMasterLayer->mChannel;
     globalVar.canBus = gCanBusContext[globalVar.VIAChannel].mBus;
-    cclCanSetMessageHandler(globalVar.VIAChannel, CCL_CAN_ALLMESSAGES, &OnCanMessage);
+//    只注册诊断相关 ID 的回调，无法按 ID 注册时回退为全部报文
+    CanMessageFilter::getInstance()->install(globalVar.VIAChannel, &OnCanMessage);
 }
 
 
+// 定时器由 TimerScheduler 按最早的截止时间装定，没有挂起任务时保持空闲
 void OnMeasurementStart() {
-    cclTimerSet(globalVar.timerID, cclTimeMilliseconds(300));
-
+    ThreadPool::getInstance()->start();
+    FrameCapture::getInstance()->start();
+    TesterPresent::getInstance()->start();
 }
 
 void OnMeasurementStop() {
-    ThreadPool::getInstance()->~ThreadPool();
+    TimerScheduler::getInstance()->clear();
+    CanMessageFilter::getInstance()->reset();
+    BusScheduler::getInstance()->reset();
+    DiagCompletion::getInstance()->reset();
+    TesterPresent::printStatistics();
+    TesterPresent::getInstance()->reset();
+    MeasurementArena::release();
+//    报文旁路的消费线程处理完剩余记录后退出
+    FrameCapture::getInstance()->stop();
+    ThreadPool::getInstance()->shutdown();
+    FrameCapture::getInstance()->report(true);
 }
 
 void OnCanMessage(struct cclCanMessage *message) {
 //    打印收到报文的时间
 //    cclPrintf("globalVar.runTime %lld", globalVar.runTime);
 //    cclPrintf("OnCanMessage %lld", message->time);
+    globalVar.runTime = message->time;
+    FrameCapture::getInstance()->push(message);
     EventMulticaster::getInstance()->notify(CanEvent, message);
 }
 
 void OnTimer(long long time, int timerID) {
 //    cclPrintf("OnTimer %lld", time);
-    globalVar.runTime = time;
-    EventMulticaster::getInstance()->notify(TimeEvent, &time);
-    cclTimerSet(globalVar.timerID, cclTimeMicroseconds(100));
+    TimerScheduler::getInstance()->onTimer(time);
 }
 
 
@@ -57,12 +72,54 @@ CAPL_DLL_INFO4 table[] = {
                 CDLL_EXPORT},
         {"Debug", (CAPL_FARCALL) debug, "DeBug",                                        "print Debug",                                   'V', 0, "",     "",                 {""}},
         {"Debug_SendDiag", (CAPL_FARCALL) Debug_SendDiag, "DeBug", "Send a diagnostic message", 'V', 2, "BD", "\001\000", {"data", "dataLength"}},
+        {"Debug_BenchFrameEncoder", (CAPL_FARCALL) Debug_BenchFrameEncoder, "DeBug", "Benchmark frame encoder throughput", 'V', 2, "LL", "\000\000", {"dataLength", "maxDLC"}},
+        {"Debug_BenchTimerWheel", (CAPL_FARCALL) Debug_BenchTimerWheel, "DeBug", "Benchmark timer wheel tick cost", 'V', 0, "", "", {""}},
+        {"Debug_BenchFramePool", (CAPL_FARCALL) Debug_BenchFramePool, "DeBug", "Benchmark frame pool allocations", 'V', 1, "L", "\000", {"dataLength"}},
+        {"Debug_BenchFrameCapture", (CAPL_FARCALL) Debug_BenchFrameCapture, "DeBug", "Benchmark CAN callback handoff", 'V', 1, "L", "\000", {"frames"}},
+        {"Debug_FrameCaptureStatistics", (CAPL_FARCALL) FrameCapture::printStatistics, "DeBug", "Print frame capture counters", 'V', 0, "", "", {""}},
+        {"Debug_ConfigFrameCapture", (CAPL_FARCALL) FrameCapture::configFrameCapture, "DeBug", "Config frame capture and DB logging", 'L', 2, "LL", "\000\000", {"enable", "logToDB"}},
+        {"Debug_ArenaStatistics", (CAPL_FARCALL) MeasurementArena::printStatistics, "DeBug", "Print live diagnostic object counters", 'V', 0, "", "", {""}},
+        {"Debug_BenchHexDecode", (CAPL_FARCALL) Debug_BenchHexDecode, "DeBug", "Benchmark HEX record data decoding", 'V', 1, "L", "\000", {"chars"}},
+        {"Debug_BenchCompress", (CAPL_FARCALL) Debug_BenchCompress, "DeBug", "Benchmark LZ4 compression of download data", 'V', 1, "L", "\000", {"dataLength"}},
+        {"Debug_BenchCrc32", (CAPL_FARCALL) Debug_BenchCrc32, "DeBug", "Benchmark CRC32 kernels used for memory checks", 'V', 1, "L", "\000", {"dataLength"}},
+        {"Debug_BenchEventRouting", (CAPL_FARCALL) Debug_BenchEventRouting, "DeBug", "Benchmark CAN id event routing", 'V', 0, "", "", {""}},
 //        Node相关
-        {"Node_CreateNode", (CAPL_FARCALL) NodeService::createNode, "Node", "Create a node", 'L', 1, "L", "\000",                                                            {"nmId"}},
+        {"Node_CreateNode", (CAPL_FARCALL) NodeService::createNode, "Node", "Create a node, or keep the existing one from an earlier measurement", 'L', 1, "L", "\000",                                                            {"nmId"}},
 //        Diag
         {"Diag_ConfigAddr",       (CAPL_FARCALL) DiagServer::configAddr,       "Diag",  "Config a Diag's address",                       'L', 4, "LLLL", "\000\000\000\000", {"NodeHandle", "PhyAddr", "FuncAddr", "RespAddr"}},
+        {"Diag_ConfigFrameFormat", (CAPL_FARCALL) DiagServer::configFrameFormat, "Diag", "Config frame format of a Diag", 'L', 5, "LLLLL", "\000\000\000\000\000", {"NodeHandle", "maxDLC", "paddingType", "addressingFormat", "extendedAddress"}},
+        {"Diag_ConfigMessageFilter", (CAPL_FARCALL) CanMessageFilter::configMessageFilter, "Diag", "Register CAN handlers per diagnostic id", 'L', 1, "L", "\000", {"enable"}},
+        {"Diag_ConfigWFTmax", (CAPL_FARCALL) DiagServer::configWFTmax, "Diag", "Config max consecutive FC.WAIT of a Diag", 'L', 2, "LL", "\000\000", {"NodeHandle", "WFTmax"}},
+        {"Diag_ConfigTxWindow", (CAPL_FARCALL) DiagServer::configTxWindow, "Diag", "Config pipelined send window of a Diag", 'L', 2, "LL", "\000\000", {"NodeHandle", "txWindow"}},
+        {"Diag_ConfigBusWeight", (CAPL_FARCALL) DiagServer::configBusWeight, "Diag", "Config bus share of a Diag when sending concurrently", 'L', 2, "LL", "\000\000", {"NodeHandle", "busWeight"}},
+        {"Diag_ConfigBusScheduler", (CAPL_FARCALL) BusScheduler::configBusScheduler, "Diag", "Config max frames in flight per channel", 'L', 1, "L", "\000", {"maxInFlight"}},
+        {"Diag_ConfigP2", (CAPL_FARCALL) UdsClient::configP2, "Diag", "Config P2Client and P2ClientEx of a Diag in ms", 'L', 3, "LLL", "\000\000\000", {"NodeHandle", "P2Client", "P2ClientEx"}},
+        {"Diag_ConfigTesterPresent", (CAPL_FARCALL) TesterPresent::configTesterPresent, "Diag", "Keep a Diag's non-default session alive with 3E 80", 'L', 2, "LL", "\000\000", {"NodeHandle", "enable"}},
+        {"Diag_ConfigPreSegment", (CAPL_FARCALL) DiagServer::configPreSegment, "Diag", "Config pre-segmentation limit of a Diag", 'L', 2, "LL", "\000\000", {"NodeHandle", "preSegmentLimit"}},
         {"Diag_SendByPhysical",   (CAPL_FARCALL) DiagServer::sendByPhysical,   "Diag",  "Send a diagnostic message by physical address", 'L', 3, "LBL",  "\000\001\000",     {"NodeHandle", "data",    "dataLength"}},
-        {"Diag_WaitDiagComplete", (CAPL_FARCALL) DiagServer::waitDiagComplete, "Diag",  "Wait for the diagnostic to complete",           'L', 1, "L",    "\000",             {"diagId"}},
+        {"Diag_SendByFunctional", (CAPL_FARCALL) DiagServer::sendByFunctional, "Diag",  "Send a single frame request by functional address", 'L', 3, "LBL", "\000\001\000",    {"NodeHandle", "data",    "dataLength"}},
+        {"Diag_GetResultCount",   (CAPL_FARCALL) FunctionalGroup::getResultCount, "Diag", "Number of ECUs in a functional result set",    'L', 1, "L",    "\000",             {"diagId"}},
+        {"Diag_GetResultAnswered", (CAPL_FARCALL) FunctionalGroup::getAnsweredCount, "Diag", "Number of ECUs that answered a functional request", 'L', 1, "L", "\000",             {"diagId"}},
+        {"Diag_GetResultDiagId",  (CAPL_FARCALL) FunctionalGroup::getResultDiagId, "Diag", "diagId of one ECU in a functional result set", 'L', 2, "LL",   "\000\000",         {"diagId", "index"}},
+        {"Diag_GetResultNode",    (CAPL_FARCALL) FunctionalGroup::getResultNode, "Diag", "NodeHandle of one ECU in a functional result set", 'L', 2, "LL", "\000\000",         {"diagId", "index"}},
+        {"Diag_GetResponse",      (CAPL_FARCALL) DiagServer::getResponse,      "Diag",  "Copy the reassembled response of a diagnostic", 'L', 3, "LBL",  "\000\001\000",     {"diagId", "buffer", "bufferSize"}},
+        {"Diag_GetDiagStatus",    (CAPL_FARCALL) DiagServer::getDiagStatus,    "Diag",  "Poll the state of a diagnostic",                'L', 1, "L",    "\000",             {"diagId"}},
+        {"Diag_GetErrorStatus",   (CAPL_FARCALL) DiagServer::getErrorStatus,   "Diag",  "Poll the error bits of a diagnostic",           'L', 1, "L",    "\000",             {"diagId"}},
+        {"Diag_GetLatency",       (CAPL_FARCALL) UdsClient::getLatency,        "Diag",  "Request to final response time in us",          'L', 1, "L",    "\000",             {"diagId"}},
+        {"Diag_ConfigCompletionSysVar", (CAPL_FARCALL) DiagCompletion::configCompletionSysVar, "Diag", "Write finished diagId to a system variable", 'L', 1, "C", "\001", {"sysVarName"}},
+        {"Flash_StartDownload", (CAPL_FARCALL) FlashDownload::startDownload, "Flash", "Download a memory mapped image with 34/36/37", 'L', 3, "LCL", "\000\001\000", {"NodeHandle", "filePath", "memoryAddress"}},
+        {"Flash_ConfigDelta", (CAPL_FARCALL) FlashDownload::configDelta, "Flash", "Region size, erase/check routine IDs and sector size for delta flashing", 'L', 5, "LLLLL", "\000\000\000\000\000", {"NodeHandle", "regionSize", "eraseRoutine", "checkRoutine", "sectorSize"}},
+        {"Flash_StartDeltaDownload", (CAPL_FARCALL) FlashDownload::startDeltaDownload, "Flash", "Download only the regions that differ from a reference", 'L', 4, "LCCL", "\000\001\001\000", {"NodeHandle", "filePath", "referencePath", "memoryAddress"}},
+        {"Flash_ConfigCompression", (CAPL_FARCALL) FlashDownload::configCompression, "Flash", "Compression method for 0x34 dataFormatIdentifier, 0 = off", 'L', 2, "LL", "\000\000", {"NodeHandle", "compressionMethod"}},
+        {"Flash_GetCompressionRatio", (CAPL_FARCALL) FlashDownload::getCompressionRatio, "Flash", "Compressed/original bytes of the last download in per mille", 'L', 1, "L", "\000", {"NodeHandle"}},
+        {"Flash_GetDownloadStatus", (CAPL_FARCALL) FlashDownload::getDownloadStatus, "Flash", "Poll the state of a download", 'L', 1, "L", "\000", {"NodeHandle"}},
+        {"Flash_GetDownloadProgress", (CAPL_FARCALL) FlashDownload::getDownloadProgress, "Flash", "Image bytes confirmed by the ECU", 'L', 1, "L", "\000", {"NodeHandle"}},
+        {"Flash_GetSegmentCount", (CAPL_FARCALL) FlashDownload::getSegmentCount, "Flash", "Number of segments in the loaded image", 'L', 1, "L", "\000", {"NodeHandle"}},
+        {"Flash_GetSegmentAddress", (CAPL_FARCALL) FlashDownload::getSegmentAddress, "Flash", "Start address of an image segment", 'L', 2, "LL", "\000\000", {"NodeHandle", "index"}},
+        {"Flash_GetSegmentLength", (CAPL_FARCALL) FlashDownload::getSegmentLength, "Flash", "Length of an image segment", 'L', 2, "LL", "\000\000", {"NodeHandle", "index"}},
+        {"Flash_GetSegmentCrc", (CAPL_FARCALL) FlashDownload::getSegmentCrc, "Flash", "CRC32 of an image segment, -1 while still computing", 'L', 3, "LLD", "\000\000\001", {"NodeHandle", "index", "crc"}},
+        {"Diag_ReleaseDiag",      (CAPL_FARCALL) DiagServer::releaseDiag,      "Diag",  "Release a finished diagnostic and its session slot", 'L', 1, "L", "\000",             {"diagId"}},
+        {"Diag_WaitDiagComplete", (CAPL_FARCALL) DiagServer::waitDiagComplete, "Diag",  "Deprecated: returns the state without waiting, use Diag_GetDiagStatus", 'L', 1, "L",    "\000",             {"diagId"}},
         {0,                0}
 };
 CAPLEXPORT CAPL_DLL_INFO4 *caplDllTable4 = table;
\ No newline at end of file
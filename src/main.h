@@ -29,11 +29,26 @@ static GlobalVar globalVar;
 #include "service/event/EventListener.h"
 #include "service/event/EventMulticaster.h"
 #include "service/event/EventMulticaster.cpp"
+#include "service/timer/TimerScheduler.h"
+#include "service/timer/TimerScheduler.cpp"
+#include "service/capture/FrameCapture.h"
+#include "service/capture/FrameCapture.cpp"
 
 #include "service/node/NodeService.h"
 #include "service/node/NodeService.cpp"
+#include "service/event/CanMessageFilter.h"
+#include "service/event/CanMessageFilter.cpp"
 #include "service/diag/DiagServer.h"
 #include "service/diag/DiagServer.cpp"
+#include "service/flash/MappedFile.cpp"
+#include "service/flash/FlashImage.cpp"
+#include "service/flash/DeltaPlan.cpp"
+#include "service/flash/IncrementalCrc.cpp"
+#include "service/flash/CompressedStream.cpp"
+#include "service/flash/FlashDownload.cpp"
+#include "service/memory/MeasurementArena.h"
+#include "service/memory/MeasurementArena.cpp"
+#include "utils/Benchmark.cpp"
 
 extern void OnMeasurementPreStart();
 
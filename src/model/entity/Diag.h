@@ -14,6 +14,11 @@ enum PaddingType {
     Padding = 0,        // 默认选择填充，DLC最小为8，当数据长度小于8时，填充CC
     NoPadding = 1,   // 即当数据类型小于8字节，不会进行填充，DLC为数据长度
 };
+// ISO 15765-2 寻址格式
+enum AddressingFormat {
+    NormalAddressing = 0,     // 普通寻址，数据第0字节即为PCI
+    ExtendedAddressing = 1,   // 扩展寻址，数据第0字节为目标地址N_TA，PCI从第1字节开始
+};
 typedef struct CanMessageConfig {
     bool RTR;
     bool Wakeup;
@@ -94,15 +99,30 @@ typedef struct FlowControlFrame {
     uint8_t STmin = 0x00;
 } FlowControlFrame;
 
+// 增量刷写默认的区域大小，应与 ECU 的擦除扇区对齐
+#define FLASH_DEFAULT_REGION_SIZE 4096
+// 未指定时假定的 ECU 擦除扇区大小，区域大小不能小于扇区
+#define FLASH_DEFAULT_SECTOR_SIZE 4096
+
+// 刷写配置，与节点一起跨测量保留
+typedef struct FlashConfig {
+    uint32_t regionSize = FLASH_DEFAULT_REGION_SIZE;  // 增量刷写的区域大小
+    uint16_t eraseRoutine = 0;      // 擦除例程ID，0表示不支持
+    uint16_t checkRoutine = 0;      // 校验例程ID，0表示不支持
+    uint8_t compressionMethod = 0;  // 0x34 dataFormatIdentifier 高4位，0表示不压缩
+} FlashConfig;
+
 typedef struct DiagConfig {
     uint16_t PhyAddr = 0x73A;
     uint16_t FuncAddr = 0x7DF;
     uint16_t RespAddr = 0x7BA;
-    NetworkLayerTime *networkLayerTime = new NetworkLayerTime();
-    SessionLayerTime *sessionLayerTime = new SessionLayerTime();
+    NetworkLayerTime networkLayerTime;
+    SessionLayerTime sessionLayerTime;
     uint8_t maxDLC = 8;
     PaddingType paddingType = Padding;
     uint8_t paddingData = 0xCC;
+    AddressingFormat addressingFormat = NormalAddressing;
+    uint8_t extendedAddress = 0x00;  // 扩展寻址时请求帧第0字节的目标地址
     CanMessageConfig canMessageConfig = {
             .RTR = false,
             .Wakeup = false,
@@ -111,9 +131,22 @@ typedef struct DiagConfig {
             .BRS = true,
             .ESI = false
     };
-    FlowControlFrame *flowControlFrame = new FlowControlFrame();
+    FlowControlFrame flowControlFrame;
+//    允许连续收到的 WAIT 流控帧数，超过后发送失败，0表示不接受 WAIT
+    uint8_t WFTmax = 10;
+//    请求长度不超过该值时在提交时整包预分帧，超过则在发送时逐帧编码，0表示关闭预分帧
+//    预分帧每帧占一个 cclCanMessage(88 字节)，默认 4 KiB 约 600 帧、50 KB；更长的请求逐帧编码
+//    引用外部数据的请求(下载的 36 传输块)不预分帧；帧数组在请求发完后归还，会话槽位不长期占用
+    uint32_t preSegmentLimit = 0x1000;
+//    可接收的最大响应长度，首帧长度超过该值时回复溢出流控帧
+    uint32_t maxReceiveLength = 0x1000000;
+//    发送窗口：STmin 为0时最多同时交给驱动、尚未收到发送确认的帧数，1表示逐帧等待确认
+    uint8_t txWindow = 1;
+//    同一通道多个节点同时发送时的总线权重，权重越大分到的帧越多
+    uint8_t busWeight = 1;
 //    容错时间，当规范时间>实际时间>规范时间+容错时间时，依然可以接收到数据，单位ms
     uint16_t faultToleranceTime = 100;
+    FlashConfig flashConfig;
 } DiagConfig;
 
 #endif //CAPLUTILS_CANMESSAGE_H
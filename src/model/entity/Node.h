@@ -15,10 +15,25 @@
 //    NetworkLayerTime *networkLayerTime;
 //    SessionLayerTime *sessionLayerTime;
 //}NodeConfig;
+class FrameEncoder;
+
+class DiagReceiver;
+
+class UdsClient;
+
+class FlashDownload;
+
 typedef struct Node {
     uint16_t NodeHandle = 0;
     uint16_t BaseId = 0;
     uint8_t EcuId = 0;
-    DiagConfig *diagConfig = new DiagConfig();
+    DiagConfig *diagConfig = nullptr;  // 与节点一起从 NodeService 的对象池分配
+    FrameEncoder *frameEncoder = nullptr;  // 按 diagConfig 选定的分帧编码器，节点配置时生成
+    DiagReceiver *diagReceiver = nullptr;  // 响应接收器，配置地址时生成
+    UdsClient *udsClient = nullptr;  // UDS 客户端，与接收器一起生成
+    FlashDownload *flashDownload = nullptr;  // 刷写下载流程，第一次下载时生成
+    uint32_t activeSessionId = 0;  // 最近一次发出请求的诊断ID，响应写入该会话
+    bool testerPresent = false;  // 是否由 TesterPresent 保持非默认会话
+    long long lastActivityTime = 0;  // 最近一次提交请求或请求结束的时间，纳秒，ECU 以此重新计 S3
 } Node;
 #endif //DLLTEST_NODE_H
@@ -6,6 +6,12 @@
 #define DLLTEST_DIAGSENDDATAV0_H
 
 #include "../entity/Diag.h"
+#include "FrameRing.h"
+#include "FrameBatch.h"
+#include "PayloadBuffer.h"
+
+// 每个会话复用的发送帧槽位数
+#define SESSION_FRAME_RING_SIZE 16
 
 // 诊断状态固定为这四个状态，不再增加，失败原因将通过errorStatus来标识
 enum DiagSessionState {
@@ -35,19 +41,71 @@ enum ErrorStatus {
 //    流控帧错误
     FlowControlError = 0x8,
     flowControlOverflow = 0x10,
+//    接收连续帧超时 N_Cr
+    ReceiveTimeout = 0x20,
+//    连续帧序号错误
+    WrongSequenceNumber = 0x40,
+//    响应长度超过 maxReceiveLength
+    ReceiveOverflow = 0x80,
+//    连续 WAIT 流控帧超过 WFTmax
+    WaitFrameOverflow = 0x100,
+//    收到否定响应(0x78 以外的 NRC)，状态仍为接收完成
+    NegativeResponse = 0x200,
 };
+// 引用外部数据发送时，会话自己保存的请求头最大长度
+#define REQUEST_HEADER_SIZE 8
+
+// 请求数据视图：header 之后接 body，header 为空时 body 即整个请求
+typedef struct RequestView {
+    const uint8_t *header = nullptr;
+    uint8_t headerLength = 0;
+    const uint8_t *body = nullptr;
+
+//    从请求的 offset 处拷贝 length 字节
+    void copy(uint32_t offset, uint8_t *target, uint32_t length) const {
+        if (offset < headerLength) {
+            uint32_t count = headerLength - offset < length ? headerLength - offset : length;
+            memcpy(target, header + offset, count);
+            target += count;
+            offset += count;
+            length -= count;
+        }
+        if (length > 0) {
+            memcpy(target, body + (offset - headerLength), length);
+        }
+    }
+
+    [[nodiscard]] uint8_t at(uint32_t index) const {
+        return index < headerLength ? header[index] : body[index - headerLength];
+    }
+} RequestView;
+
 typedef struct DiagSession {
     uint32_t id;
     AddressingMode addressingMode = physical;
     DiagSessionState diagSessionState;  // 状态
     uint32 errorStatus;  // 异常状态 ErrorStatus
-    std::vector<cclCanMessage *> sendData;   // 已发送的数据
+    FrameRing<SESSION_FRAME_RING_SIZE> sendData;   // 已发送的数据，环形复用，不再逐帧 new
     std::vector<cclCanMessage *> receiveData; // 已接收的数据
-    uint32_t dataLength = 0;
-    uint8_t *data = nullptr;
+    std::vector<uint8_t> responseData; // 重组后的响应，首帧到达时按总长度一次性分配
+    uint32_t dataLength = 0;  // 请求总长度，包括 header
+    const uint8_t *data = nullptr;  // 正在发送的请求数据，指向 payload，或指向调用方引用的数据(接在 header 之后)
+    PayloadBuffer payload;  // 提交时拷贝的请求数据，会话自己持有
+    uint8_t header[REQUEST_HEADER_SIZE] = {};  // 引用外部数据时的请求头，例如 36 SN
+    uint8_t headerLength = 0;
     bool parsed = false;// 解析是否完成？
     uint32_t offset = 0;// 偏移量
     uint8_t SN = 0;// 连续帧序号
+    bool preSegmented = false;// 是否已在提交时整包预分帧
+    FrameBatch frameBatch;// 预分帧结果
+    uint8_t serviceId = 0;// 请求的服务ID，用于匹配响应
+    bool suppressPositiveResponse = false;// 请求带 SPRMIB，不期待正响应
+    uint8_t responsePendingCount = 0;// 收到的 NRC 0x78 次数
+    long long requestTime = 0;// 提交时间，纳秒
+    long long responseTime = 0;// 最终响应或超时的时间，纳秒
+    uint16_t nodeHandle = 0;// 发出请求或接收响应的节点
+    uint32_t groupId = 0;// 功能请求成员所属的功能请求诊断ID
+    std::vector<uint32_t> members;// 功能请求的成员会话
 
 //    设置errorStatus
     void setErrorStatus(ErrorStatus status) {
@@ -58,5 +116,55 @@ typedef struct DiagSession {
     bool getErrorStatus(ErrorStatus status) {
         return this->errorStatus & status;
     }
+
+//    会话表复用槽位时清空上一次请求的状态，保留帧环、预分帧、请求块和响应缓冲区已申请的容量
+    void reset() {
+        id = 0;
+        addressingMode = physical;
+        diagSessionState = sendUnfinished;
+        errorStatus = 0;
+        sendData.reset();
+        receiveData.clear();
+        responseData.clear();
+        dataLength = 0;
+        data = nullptr;
+        headerLength = 0;
+        parsed = false;
+        offset = 0;
+        SN = 0;
+        preSegmented = false;
+        frameBatch.clear();
+        serviceId = 0;
+        suppressPositiveResponse = false;
+        responsePendingCount = 0;
+        requestTime = 0;
+        responseTime = 0;
+        nodeHandle = 0;
+        groupId = 0;
+        members.clear();
+    }
+
+//    拷贝请求数据到会话自己的存储，调用方的数组随后即可复用
+    void assignPayload(const uint8_t *source, uint32_t sourceLength) {
+        data = payload.assign(source, sourceLength);
+        dataLength = sourceLength;
+    }
+
+//    引用调用方的数据而不拷贝：请求 = header + body，body 必须保持有效直到请求发完
+    void referencePayload(const uint8_t *source, uint8_t sourceLength, const uint8_t *body, uint32_t bodyLength) {
+        memcpy(header, source, sourceLength);
+        headerLength = sourceLength;
+        data = body;
+        dataLength = sourceLength + bodyLength;
+    }
+
+    [[nodiscard]] RequestView request() const {
+        return {header, headerLength, data};
+    }
+
+//    是否已进入终态：接收完成或失败
+    [[nodiscard]] bool isFinished() const {
+        return diagSessionState == received || diagSessionState == failed;
+    }
 } DiagSession;
 #endif //DLLTEST_DIAGSENDDATAV0_H
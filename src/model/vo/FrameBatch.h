@@ -0,0 +1,50 @@
+﻿#ifndef DLLTEST_FRAMEBATCH_H
+#define DLLTEST_FRAMEBATCH_H
+
+#include <vector>
+#include "vector/CCL/CCL.h"
+
+#define FRAME_BATCH_KEEP_FRAMES 16  // 发送结束后保留的帧容量，单帧和短多帧请求复用，长请求的帧数组归还
+
+/*
+ * FrameBatch  整包预分帧结果
+ * 请求提交时一次性把 SF 或 FF + 全部 CF 编码进连续数组，发送路径只需按顺序取下一帧
+ * */
+typedef struct FrameBatch {
+    std::vector<cclCanMessage> frames;
+    uint32_t cursor = 0;  // 下一帧的下标
+
+//    是否还有未发送的帧
+    [[nodiscard]] bool ready() const {
+        return cursor < frames.size();
+    }
+
+    cclCanMessage *next() {
+        return ready() ? &frames[cursor++] : nullptr;
+    }
+
+//    清空帧但保留容量，便于复用
+    void clear() {
+        frames.clear();
+        cursor = 0;
+    }
+
+//    清空后按本次帧数分配；之前的大请求留下的容量超过所需4倍时归还，槽位不会一直占着整包的内存
+    void reset(uint32_t frameCount) {
+        if (frames.capacity() > 4 * static_cast<size_t>(frameCount) + 16) {
+            std::vector<cclCanMessage>().swap(frames);
+        }
+        clear();
+        frames.resize(frameCount);
+    }
+
+//    请求发完或失败后调用；会话槽位会被长期保留，长请求的帧数组不能一直占着
+    void release() {
+        if (frames.capacity() > FRAME_BATCH_KEEP_FRAMES) {
+            std::vector<cclCanMessage>().swap(frames);
+        }
+        clear();
+    }
+} FrameBatch;
+
+#endif //DLLTEST_FRAMEBATCH_H
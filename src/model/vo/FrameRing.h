@@ -0,0 +1,71 @@
+#ifndef DLLTEST_FRAMERING_H
+#define DLLTEST_FRAMERING_H
+
+#include <cstring>
+#include "vector/CCL/CCL.h"
+
+// 帧池统计，用于验证会话开始后发送路径不再逐帧申请堆内存
+typedef struct FramePoolStatistics {
+    uint64_t heapAllocations = 0;  // 帧存储的堆申请次数，每个会话只申请一次
+    uint64_t framesAcquired = 0;   // 从帧池中取出的帧数
+} FramePoolStatistics;
+static FramePoolStatistics framePoolStatistics;
+
+/*
+ * FrameRing  会话内的帧环形缓冲区
+ * 会话创建时一次性申请 Capacity 个槽位，之后每一帧都复用槽位，不再 new cclCanMessage
+ * 只有最近 Capacity 帧有效，调用方不能长期持有更早的帧指针
+ * */
+template<uint32_t Capacity>
+class FrameRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "FrameRing 容量必须是2的幂");
+private:
+    cclCanMessage *frames;
+//    累计取出的帧数，槽位下标 = count & (Capacity - 1)
+    uint32_t count = 0;
+
+public:
+    FrameRing() {
+        frames = new cclCanMessage[Capacity]();
+        framePoolStatistics.heapAllocations++;
+    }
+
+    ~FrameRing() {
+        delete[] frames;
+        frames = nullptr;
+    }
+
+//    禁止拷贝构造
+    FrameRing(const FrameRing &frameRing) = delete;
+
+    FrameRing &operator=(const FrameRing &frameRing) = delete;
+
+//    取出下一个槽位，并清空旧数据
+    cclCanMessage *acquire() {
+        cclCanMessage *frame = &frames[count & (Capacity - 1)];
+        memset(frame, 0, sizeof(cclCanMessage));
+        count++;
+        framePoolStatistics.framesAcquired++;
+        return frame;
+    }
+
+//    最近一次取出的帧
+    [[nodiscard]] cclCanMessage *back() const {
+        return count == 0 ? nullptr : &frames[(count - 1) & (Capacity - 1)];
+    }
+
+    [[nodiscard]] bool empty() const {
+        return count == 0;
+    }
+
+//    累计取出的帧数
+    [[nodiscard]] uint32_t size() const {
+        return count;
+    }
+
+    void reset() {
+        count = 0;
+    }
+};
+
+#endif //DLLTEST_FRAMERING_H
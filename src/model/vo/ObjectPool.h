@@ -0,0 +1,113 @@
+﻿#ifndef DLLTEST_OBJECTPOOL_H
+#define DLLTEST_OBJECTPOOL_H
+
+#include <new>
+#include <utility>
+#include <vector>
+
+// 对象池统计，测量结束时打印，用于确认多次测量之间不再累积对象
+typedef struct ObjectPoolStatistics {
+    uint32_t live = 0;      // 当前存活的对象数
+    uint32_t peak = 0;      // 本次测量中同时存活的最大对象数
+    uint64_t created = 0;   // 本次测量中累计创建的对象数
+    uint32_t chunks = 0;    // 已申请的存储块数
+} ObjectPoolStatistics;
+
+/*
+ * ObjectPool  按块申请存储的对象池
+ * 每次向堆申请 ChunkSize 个槽位，对象析构后槽位进入空闲链表，由下一次 create 复用，
+ * clear 析构所有存活对象并一次性归还全部存储块
+ * 空闲链表指针放在对象存储之外，release 后槽位内容保持不变，直到下一次 create
+ * */
+template<typename T, uint32_t ChunkSize = 32>
+class ObjectPool {
+private:
+    typedef struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        Slot *next;
+        bool alive;
+    } Slot;
+
+    std::vector<Slot *> chunks;
+    Slot *freeList = nullptr;
+    ObjectPoolStatistics statistics;
+
+    void grow() {
+        auto *chunk = new Slot[ChunkSize];
+        for (uint32_t i = ChunkSize; i > 0; --i) {
+            chunk[i - 1].alive = false;
+            chunk[i - 1].next = freeList;
+            freeList = &chunk[i - 1];
+        }
+        chunks.push_back(chunk);
+        statistics.chunks++;
+    }
+
+public:
+    ObjectPool() = default;
+
+//    禁止拷贝构造
+    ObjectPool(const ObjectPool &objectPool) = delete;
+
+    ObjectPool &operator=(const ObjectPool &objectPool) = delete;
+
+    ~ObjectPool() {
+        clear();
+    }
+
+    template<typename... Args>
+    T *create(Args &&... args) {
+        if (freeList == nullptr) {
+            grow();
+        }
+        Slot *slot = freeList;
+        freeList = slot->next;
+        T *object = new(slot->storage) T(std::forward<Args>(args)...);
+        slot->alive = true;
+        statistics.created++;
+        if (++statistics.live > statistics.peak) {
+            statistics.peak = statistics.live;
+        }
+        return object;
+    }
+
+//    析构对象并归还槽位，重复调用或传入空指针无影响
+    void release(T *object) {
+        if (object == nullptr) {
+            return;
+        }
+        auto *slot = reinterpret_cast<Slot *>(object);
+        if (!slot->alive) {
+            return;
+        }
+        slot->alive = false;
+        object->~T();
+        slot->next = freeList;
+        freeList = slot;
+        statistics.live--;
+    }
+
+//    析构所有存活对象，释放全部存储块
+    void clear() {
+        for (Slot *chunk: chunks) {
+            for (uint32_t i = 0; i < ChunkSize; ++i) {
+                if (chunk[i].alive) {
+                    chunk[i].alive = false;
+                    reinterpret_cast<T *>(chunk[i].storage)->~T();
+                }
+            }
+        }
+        for (Slot *chunk: chunks) {
+            delete[] chunk;
+        }
+        chunks.clear();
+        freeList = nullptr;
+        statistics = ObjectPoolStatistics();
+    }
+
+    [[nodiscard]] const ObjectPoolStatistics &getStatistics() const {
+        return statistics;
+    }
+};
+
+#endif //DLLTEST_OBJECTPOOL_H
@@ -0,0 +1,149 @@
+﻿#ifndef DLLTEST_PAYLOADBUFFER_H
+#define DLLTEST_PAYLOADBUFFER_H
+
+#include <cstring>
+#include <vector>
+
+// 内联存储的最大请求长度，等于 CAN FD 单帧可携带的最大数据长度
+#define PAYLOAD_INLINE_SIZE 62
+// 块按2的幂分级，最小 128 字节
+#define PAYLOAD_MIN_CHUNK_SHIFT 7
+#define PAYLOAD_CHUNK_CLASSES (32 - PAYLOAD_MIN_CHUNK_SHIFT)
+
+// 请求数据块池统计
+typedef struct PayloadPoolStatistics {
+    uint64_t heapAllocations = 0;  // 向堆申请块的次数
+    uint64_t reused = 0;           // 从池中取回已有块的次数
+    uint64_t cachedBytes = 0;      // 池中空闲块的总字节数
+} PayloadPoolStatistics;
+
+/*
+ * PayloadPool  超过内联长度的请求数据块池
+ * 块按 2 的幂分级，会话归还的块按级别缓存，之后同级的请求直接取回，不再申请堆内存
+ * 只在 CANoe 线程使用；测量结束时 clear 释放全部缓存
+ * */
+class PayloadPool {
+private:
+    std::vector<uint8_t *> freeChunks[PAYLOAD_CHUNK_CLASSES];
+    PayloadPoolStatistics statistics;
+
+    static uint32_t chunkClass(uint32_t length) {
+        uint32_t shift = PAYLOAD_MIN_CHUNK_SHIFT;
+        while (shift < 31 && (1u << shift) < length) {
+            shift++;
+        }
+        return shift - PAYLOAD_MIN_CHUNK_SHIFT;
+    }
+
+public:
+    static PayloadPool *getInstance() {
+        static PayloadPool *instance = nullptr;
+        if (instance == nullptr) {
+            instance = new PayloadPool();
+        }
+        return instance;
+    }
+
+//    取一个至少 length 字节的块，capacity 返回块的实际大小
+    uint8_t *acquire(uint32_t length, uint32_t *capacity) {
+        uint32_t level = chunkClass(length);
+        *capacity = 1u << (level + PAYLOAD_MIN_CHUNK_SHIFT);
+        std::vector<uint8_t *> &chunks = freeChunks[level];
+        if (!chunks.empty()) {
+            uint8_t *chunk = chunks.back();
+            chunks.pop_back();
+            statistics.reused++;
+            statistics.cachedBytes -= *capacity;
+            return chunk;
+        }
+        statistics.heapAllocations++;
+        return new uint8_t[*capacity];
+    }
+
+    void release(uint8_t *chunk, uint32_t capacity) {
+        freeChunks[chunkClass(capacity)].push_back(chunk);
+        statistics.cachedBytes += capacity;
+    }
+
+//    释放全部缓存的块
+    void clear() {
+        for (auto &chunks: freeChunks) {
+            for (uint8_t *chunk: chunks) {
+                delete[] chunk;
+            }
+            std::vector<uint8_t *>().swap(chunks);
+        }
+        statistics.cachedBytes = 0;
+    }
+
+    [[nodiscard]] const PayloadPoolStatistics &getStatistics() const {
+        return statistics;
+    }
+};
+
+/*
+ * PayloadBuffer  会话持有的请求数据
+ * 提交时从 CAPL 数组拷贝一次，CAPL 返回后即可复用自己的数组
+ * 不超过 PAYLOAD_INLINE_SIZE 字节时存放在内联数组中，不申请堆内存；更长的请求使用 PayloadPool 的一个块，
+ * 会话槽位复用时块保留，下一个请求放得下就直接覆盖
+ * */
+class PayloadBuffer {
+private:
+    uint8_t inlineData[PAYLOAD_INLINE_SIZE] = {};
+    uint8_t *chunk = nullptr;
+    uint32_t chunkCapacity = 0;
+    uint32_t length = 0;
+
+public:
+    PayloadBuffer() = default;
+
+//    禁止拷贝构造
+    PayloadBuffer(const PayloadBuffer &payloadBuffer) = delete;
+
+    PayloadBuffer &operator=(const PayloadBuffer &payloadBuffer) = delete;
+
+    ~PayloadBuffer() {
+        release();
+    }
+
+//    拷贝请求数据，返回内部存储的地址
+    uint8_t *assign(const uint8_t *source, uint32_t sourceLength) {
+        uint8_t *target;
+        if (sourceLength <= PAYLOAD_INLINE_SIZE) {
+//            短请求用不到块，还给池子供其他会话使用
+            release();
+            target = inlineData;
+        } else {
+            if (chunkCapacity < sourceLength) {
+                release();
+                chunk = PayloadPool::getInstance()->acquire(sourceLength, &chunkCapacity);
+            }
+            target = chunk;
+        }
+        if (sourceLength > 0) {
+            memcpy(target, source, sourceLength);
+        }
+        length = sourceLength;
+        return target;
+    }
+
+//    把块还给 PayloadPool
+    void release() {
+        if (chunk != nullptr) {
+            PayloadPool::getInstance()->release(chunk, chunkCapacity);
+            chunk = nullptr;
+            chunkCapacity = 0;
+        }
+        length = 0;
+    }
+
+    [[nodiscard]] uint8_t *data() {
+        return chunk != nullptr ? chunk : inlineData;
+    }
+
+    [[nodiscard]] uint32_t size() const {
+        return length;
+    }
+};
+
+#endif //DLLTEST_PAYLOADBUFFER_H
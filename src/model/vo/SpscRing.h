@@ -0,0 +1,71 @@
+﻿#ifndef DLLTEST_SPSCRING_H
+#define DLLTEST_SPSCRING_H
+
+#include <atomic>
+
+/*
+ * SpscRing  单生产者单消费者无锁环形队列
+ * 生产者为 CANoe 回调线程，消费者为 ThreadPool 中的一个工作线程
+ * 容量固定，队列满时 push 直接返回 false，由调用方记录溢出
+ * */
+template<typename T, uint32_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing 容量必须是2的幂");
+private:
+    T *items;
+//    head 只由生产者写，tail 只由消费者写，分开缓存行避免伪共享
+    alignas(64) std::atomic<uint32_t> head{0};
+    alignas(64) std::atomic<uint32_t> tail{0};
+
+public:
+    SpscRing() {
+        items = new T[Capacity]();
+    }
+
+    ~SpscRing() {
+        delete[] items;
+        items = nullptr;
+    }
+
+//    禁止拷贝构造
+    SpscRing(const SpscRing &spscRing) = delete;
+
+    SpscRing &operator=(const SpscRing &spscRing) = delete;
+
+//    生产者调用，返回写入的槽位，队列满时返回 nullptr；写完后必须调用 commit
+    T *reserve() {
+        uint32_t position = head.load(std::memory_order_relaxed);
+        if (position - tail.load(std::memory_order_acquire) >= Capacity) {
+            return nullptr;
+        }
+        return &items[position & (Capacity - 1)];
+    }
+
+    void commit() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+//    消费者调用，返回队首元素，队列空时返回 nullptr；处理完后必须调用 release
+    T *front() {
+        uint32_t position = tail.load(std::memory_order_relaxed);
+        if (position == head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &items[position & (Capacity - 1)];
+    }
+
+    void release() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+//    当前元素个数，只作统计用
+    [[nodiscard]] uint32_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity() {
+        return Capacity;
+    }
+};
+
+#endif //DLLTEST_SPSCRING_H
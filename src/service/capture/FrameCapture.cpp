@@ -0,0 +1,81 @@
+﻿#include "FrameCapture.h"
+
+void FrameCapture::start() {
+    if (!enabled || running.exchange(true)) {
+        return;
+    }
+    capturing = true;
+    idStatistics.clear();
+    worker = std::thread([this] { drain(); });
+}
+
+void FrameCapture::stop() {
+    capturing = false;
+    running.store(false, std::memory_order_release);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void FrameCapture::drain() {
+    for (;;) {
+        bool stopping = !running.load(std::memory_order_acquire);
+        uint32_t count = 0;
+        for (FrameRecord *record = ring.front(); record != nullptr; record = ring.front()) {
+            process(record);
+            ring.release();
+            count++;
+        }
+        drained.fetch_add(count, std::memory_order_relaxed);
+//        先读停止标志再清空队列，保证退出前已处理完停止前写入的全部记录
+        if (stopping) {
+            return;
+        }
+        if (count == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void FrameCapture::process(const FrameRecord *record) {
+    FrameIdStatistics &statistics = idStatistics[record->id];
+    statistics.frames++;
+    statistics.bytes += record->dataLength;
+    statistics.lastTime = record->time;
+    if (!logToDB) {
+        return;
+    }
+    char message[3 * 64 + 48];
+    int length = snprintf(message, sizeof(message), "%lld %s 0x%X [%d]", record->time,
+                          record->dir == kVIA_Tx ? "Tx" : "Rx", record->id, record->dataLength);
+    for (uint8_t i = 0; i < record->dataLength; ++i) {
+        length += snprintf(message + length, sizeof(message) - length, " %02X", record->data[i]);
+    }
+    Log log;
+    log.level = LOG_DEBUG;
+    log.tag = "CAN";
+    log.message = message;
+    DBHelper::getInstance()->insertLog(log);
+}
+
+void FrameCapture::report(bool detail) {
+    cclPrintf("FrameCapture captured=%llu drained=%llu dropped=%llu highWater=%u/%u",
+              captured.load(), drained.load(), dropped.load(), highWater.load(), ring.capacity());
+    if (!detail) {
+        return;
+    }
+    for (auto &item: idStatistics) {
+        cclPrintf("FrameCapture id=0x%X frames=%llu bytes=%llu", item.first, item.second.frames, item.second.bytes);
+    }
+}
+
+int8_t FrameCapture::configFrameCapture(uint8_t enable, uint8_t logToDB) {
+    FrameCapture *frameCapture = getInstance();
+    frameCapture->enabled = enable != 0;
+    frameCapture->logToDB = logToDB != 0;
+    return 1;
+}
+
+void FrameCapture::printStatistics() {
+    getInstance()->report(false);
+}
@@ -0,0 +1,109 @@
+﻿#ifndef DLLTEST_FRAMECAPTURE_H
+#define DLLTEST_FRAMECAPTURE_H
+
+#include <thread>
+#include <unordered_map>
+#include "../../model/vo/SpscRing.h"
+
+#define FRAME_CAPTURE_RING_SIZE 4096
+
+// 回调线程交给工作线程的精简报文记录
+typedef struct FrameRecord {
+    long long time;
+    uint32_t id;
+    uint32_t flags;
+    uint8_t channel;
+    uint8_t dir;
+    uint8_t dataLength;
+    uint8_t data[64];
+} FrameRecord;
+
+// 按 CAN ID 统计的收发情况，只由工作线程写
+typedef struct FrameIdStatistics {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    long long lastTime = 0;
+} FrameIdStatistics;
+
+/*
+ * FrameCapture  报文旁路
+ * OnCanMessage 只把报文拷贝进无锁环形队列，统计和数据库日志等非实时工作由专用的消费线程处理
+ * 消费循环在整个测量期间轮询，不占用 ThreadPool 的工作线程，CRC、缓存和压缩任务仍能用满线程池
+ * 协议处理(流控、发送确认)仍在回调线程同步完成，因为 CCL 的发送和定时器接口只能在 CANoe 线程调用
+ * */
+class FrameCapture {
+private:
+    SpscRing<FrameRecord, FRAME_CAPTURE_RING_SIZE> ring;
+    std::atomic<bool> running{false};
+    std::thread worker;
+//    本次测量是否在采集，只在 CANoe 线程读写
+    bool capturing = false;
+    bool enabled = true;
+    bool logToDB = false;
+
+//    以下计数只由回调线程写
+    std::atomic<uint64_t> captured{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint32_t> highWater{0};
+//    以下数据只由工作线程写，测量结束线程退出后才读取
+    std::atomic<uint64_t> drained{0};
+    std::unordered_map<uint32_t, FrameIdStatistics> idStatistics;
+
+    void drain();
+
+    void process(const FrameRecord *record);
+
+public:
+    static FrameCapture *getInstance() {
+        static FrameCapture *instance = nullptr;
+        if (instance == nullptr) {
+            instance = new FrameCapture();
+        }
+        return instance;
+    }
+
+//    CANoe 回调线程调用，只做一次定长拷贝
+    void push(const cclCanMessage *message) {
+        if (!capturing) {
+            return;
+        }
+        FrameRecord *record = ring.reserve();
+        if (record == nullptr) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        record->time = message->time;
+        record->id = message->id;
+        record->flags = message->flags;
+        record->channel = static_cast<uint8_t>(message->channel);
+        record->dir = message->dir;
+        record->dataLength = message->dataLength > 64 ? 64 : message->dataLength;
+        memcpy(record->data, message->data, record->dataLength);
+        ring.commit();
+        captured.store(captured.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        uint32_t size = ring.size();
+        if (size > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(size, std::memory_order_relaxed);
+        }
+    }
+
+//    测量开始时启动消费线程
+    void start();
+
+//    通知消费线程处理完剩余记录后退出，并等待它结束
+    void stop();
+
+//    打印计数，测量结束后同时打印按 ID 的统计
+    void report(bool detail);
+
+    static int8_t configFrameCapture(uint8_t enable, uint8_t logToDB);
+
+    static void printStatistics();
+
+    ~FrameCapture() {
+        stop();
+    }
+};
+
+
+#endif //DLLTEST_FRAMECAPTURE_H
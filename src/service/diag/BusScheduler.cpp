@@ -0,0 +1,69 @@
+﻿#include "BusScheduler.h"
+
+void BusScheduler::request(DiagTransmitter *transmitter) {
+    if (transmitter->queued) {
+        return;
+    }
+    transmitter->queued = true;
+    transmitter->busPass = transmitter->busPass > virtualTime ? transmitter->busPass : virtualTime;
+    ready.push_back(transmitter);
+    dispatch();
+}
+
+void BusScheduler::release(DiagTransmitter *transmitter) {
+    if (transmitter->inFlight == 0) {
+        return;
+    }
+    transmitter->inFlight--;
+    inFlight--;
+    dispatch();
+}
+
+void BusScheduler::remove(DiagTransmitter *transmitter) {
+    if (transmitter->queued) {
+        std::erase(ready, transmitter);
+        transmitter->queued = false;
+    }
+    inFlight -= transmitter->inFlight;
+    transmitter->inFlight = 0;
+    dispatch();
+}
+
+void BusScheduler::dispatch() {
+//    transmit 中发送失败会回调 remove，这里不重入
+    if (dispatching) {
+        return;
+    }
+    dispatching = true;
+    while (inFlight < maxInFlight && !ready.empty()) {
+        size_t next = 0;
+        for (size_t i = 1; i < ready.size(); ++i) {
+            if (ready[i]->busPass < ready[next]->busPass) {
+                next = i;
+            }
+        }
+        DiagTransmitter *transmitter = ready[next];
+        ready[next] = ready.back();
+        ready.pop_back();
+        transmitter->queued = false;
+        virtualTime = transmitter->busPass;
+        uint8_t weight = transmitter->node->diagConfig->busWeight;
+        transmitter->busPass += STRIDE / (weight == 0 ? 1 : weight);
+        transmitter->inFlight++;
+        inFlight++;
+        transmitter->transmit();
+    }
+    dispatching = false;
+}
+
+void BusScheduler::reset() {
+    ready.clear();
+    inFlight = 0;
+    virtualTime = 0;
+    dispatching = false;
+}
+
+int8_t BusScheduler::configBusScheduler(uint32_t maxInFlight) {
+    getInstance()->maxInFlight = maxInFlight == 0 ? 1 : maxInFlight;
+    return 1;
+}
@@ -0,0 +1,54 @@
+﻿#ifndef DLLTEST_BUSSCHEDULER_H
+#define DLLTEST_BUSSCHEDULER_H
+
+#include <vector>
+
+class DiagTransmitter;
+
+/*
+ * BusScheduler  同一通道上多个发送器的总线调度
+ * 发送器满足发送条件后不直接发帧，而是向调度器申请；调度器限制已交给驱动但未收到发送确认的帧数，
+ * 名额空出时按步幅调度(stride scheduling)挑选 pass 最小的发送器，节点的 busWeight 越大步幅越小、分到的帧越多
+ * 某个节点在等 STmin 或流控帧时，其他节点的帧自然填进总线空闲
+ * */
+class BusScheduler {
+private:
+    static constexpr uint64_t STRIDE = 1 << 16;
+
+//    已满足发送条件、等待总线名额的发送器
+    std::vector<DiagTransmitter *> ready;
+    uint32_t inFlight = 0;
+    uint32_t maxInFlight = 8;
+//    最近一次被调度的发送器的 pass，新加入的发送器从这里开始，避免积攒额度后突发
+    uint64_t virtualTime = 0;
+    bool dispatching = false;
+
+    void dispatch();
+
+public:
+    static BusScheduler *getInstance() {
+        static BusScheduler *instance = nullptr;
+        if (instance == nullptr) {
+            instance = new BusScheduler();
+        }
+        return instance;
+    }
+
+//    发送器满足发送条件，排队等待发送名额
+    void request(DiagTransmitter *transmitter);
+
+//    收到发送确认，归还名额
+    void release(DiagTransmitter *transmitter);
+
+//    发送器结束(完成、失败或超时)，从队列中移除并归还名额
+    void remove(DiagTransmitter *transmitter);
+
+//    测量结束
+    void reset();
+
+//    配置同时在途的最大帧数
+    static int8_t configBusScheduler(uint32_t maxInFlight);
+};
+
+
+#endif //DLLTEST_BUSSCHEDULER_H
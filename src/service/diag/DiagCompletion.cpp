@@ -0,0 +1,58 @@
+﻿#include "DiagCompletion.h"
+
+void DiagCompletion::resolve() {
+    sysVarID = -1;
+    if (sysVarName.empty()) {
+        return;
+    }
+    int32_t result = cclSysVarGetID(sysVarName.c_str());
+//    测量开始前配置时无法解析，等 OnMeasurementPreStart 再解析
+    if (result == CCL_WRONGSTATE) {
+        return;
+    }
+    if (result < 0) {
+        cclPrintf("DiagCompletion 系统变量 %s 不存在 %d", sysVarName.c_str(), result);
+        return;
+    }
+    sysVarID = result;
+}
+
+void DiagCompletion::reset() {
+    sysVarID = -1;
+}
+
+void DiagCompletion::notify(DiagSession *session) {
+    SessionTable::getInstance()->retire(session);
+    if (sysVarID >= 0) {
+        cclSysVarSetInteger(sysVarID, static_cast<int32_t>(session->id));
+    }
+    {
+//        状态在加锁前已写入，加锁保证等待方检查条件时能看到
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    condition.notify_all();
+//    功能请求的成员全部结束后，功能请求本身再通知一次
+    FunctionalGroup::onFinished(session);
+//    下载流程的请求结束后发出下一个请求
+    FlashDownload::onFinished(session);
+}
+
+int DiagCompletion::waitFor(uint32_t diagId, std::chrono::milliseconds timeout) {
+    SessionTable *sessionTable = SessionTable::getInstance();
+    std::unique_lock<std::mutex> lock(mutex);
+//    每次唤醒都按诊断ID重新查找，槽位复用后不会读到别的会话
+    condition.wait_for(lock, timeout, [sessionTable, diagId] {
+        DiagSession *session = sessionTable->find(diagId);
+        return session == nullptr || session->isFinished();
+    });
+    DiagSession *session = sessionTable->find(diagId);
+    return session == nullptr ? -1 : session->diagSessionState;
+}
+
+int8_t DiagCompletion::configCompletionSysVar(char *sysVarName) {
+    DiagCompletion *completion = getInstance();
+    completion->sysVarName = sysVarName == nullptr ? "" : sysVarName;
+//    测量进行中配置时立即生效
+    completion->resolve();
+    return 1;
+}
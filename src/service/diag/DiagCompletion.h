@@ -0,0 +1,55 @@
+﻿#ifndef DLLTEST_DIAGCOMPLETION_H
+#define DLLTEST_DIAGCOMPLETION_H
+
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include "../../model/vo/DiagV0.h"
+#include "SessionTable.h"
+#include "../uds/FunctionalGroup.h"
+#include "../flash/FlashDownload.h"
+
+/*
+ * DiagCompletion  诊断完成通知
+ * 会话进入终态(接收完成或失败)时在 CANoe 线程调用 notify：
+ * 配置了系统变量时把诊断ID写入系统变量，CAPL 用 on sysvar 响应；同时唤醒在工作线程中等待的调用方
+ * CAPL 运行在仿真线程上，不能阻塞等待，只能轮询状态或等系统变量
+ * */
+class DiagCompletion {
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::string sysVarName;
+    int32_t sysVarID = -1;
+
+public:
+    static DiagCompletion *getInstance() {
+        static DiagCompletion *instance = nullptr;
+        if (instance == nullptr) {
+            instance = new DiagCompletion();
+        }
+        return instance;
+    }
+
+//    会话表的读写也用这把锁，工作线程查找会话时与仿真线程分配、复用槽位互斥
+    std::mutex &sessionMutex() {
+        return mutex;
+    }
+
+//    测量开始前解析系统变量ID
+    void resolve();
+
+    void reset();
+
+//    会话进入终态，CANoe 线程调用，会话随即进入会话表的回收队列
+    void notify(DiagSession *session);
+
+//    工作线程调用，最多等待 timeout，返回会话状态；诊断不存在或等待期间槽位被复用时返回-1
+    int waitFor(uint32_t diagId, std::chrono::milliseconds timeout);
+
+//    配置完成通知的系统变量，格式 namespace::variable，传空字符串关闭
+    static int8_t configCompletionSysVar(char *sysVarName);
+};
+
+
+#endif //DLLTEST_DIAGCOMPLETION_H
@@ -26,7 +26,7 @@ uint8_t getDLC(uint32_t dataLength) {
     return 0;
 }
 
-bool copy(uint8_t dest[], uint8_t offset, uint8_t src[], uint8_t length, uint8_t paddingData) {
+bool copy(uint8_t dest[], uint8_t offset, const uint8_t src[], uint8_t length, uint8_t paddingData) {
     if (length > 64) {
         cclPrintf("数据长度超过64，不应该进入copy");
         return false;
@@ -49,7 +49,7 @@ cclCanMessage *SF_Parsing::parse(DiagSession *parsingDTO, DiagConfig *diagConfig
         parsingDTO->parsed = true;
         return {};
     }
-    auto *canMessageVO = new cclCanMessage();
+    auto *canMessageVO = parsingDTO->sendData.acquire();
     canMessageVO->id = parsingDTO->addressingMode == physical ? diagConfig->PhyAddr : diagConfig->FuncAddr;
     canMessageVO->flags = createFlag(diagConfig->canMessageConfig);
     // 处理长度小于8的情况
@@ -91,7 +91,7 @@ cclCanMessage *FF_Parsing::parse(DiagSession *parsingDTO, DiagConfig *diagConfig
         return {};
     }
     // 1、生成首帧
-    auto *FF = new cclCanMessage();
+    auto *FF = parsingDTO->sendData.acquire();
     FF->id = parsingDTO->addressingMode == physical ? diagConfig->PhyAddr : diagConfig->FuncAddr;
     FF->flags = createFlag(diagConfig->canMessageConfig);
     FF->dataLength = DLC_ActualLength[diagConfig->maxDLC];
@@ -128,7 +128,7 @@ cclCanMessage *CF_Parsing::parse(DiagSession *parsingDTO, DiagConfig *diagConfig
         parsingDTO->parsed = true;
         return {};
     }
-    auto *CF = new cclCanMessage();
+    auto *CF = parsingDTO->sendData.acquire();
     CF->id = parsingDTO->addressingMode == physical ? diagConfig->PhyAddr : diagConfig->FuncAddr;
     CF->flags = createFlag(diagConfig->canMessageConfig);
     if (parsingDTO->dataLength - parsingDTO->offset > DLC_ActualLength[diagConfig->maxDLC] - 1) {
@@ -2,3 +2,205 @@
 // Created by 87837 on 2024/6/24.
 //
 
+#include "DiagReceiver.h"
+
+DiagReceiver::DiagReceiver(Node *node) {
+    this->node = node;
+    receiveTimeoutTask.listener = this;
+    receiveTimeoutTask.timerType = NCrTimer;
+    listen();
+}
+
+void DiagReceiver::listen() {
+    if (channel == globalVar.VIAChannel) {
+        return;
+    }
+    EventMulticaster::getInstance()->removeListener(this);
+    channel = globalVar.VIAChannel;
+    EventMulticaster::getInstance()->addCanListener(this, channel, node->diagConfig->RespAddr);
+}
+
+bool DiagReceiver::onEvent(EventType type, void *event) {
+    if (type == TimeEvent) {
+        if (static_cast<TimerEvent *>(event)->timerType == NCrTimer && receiving) {
+            abort(ReceiveTimeout, "DiagReceiver 连续帧接收超时");
+        }
+        return false;
+    }
+    if (type != CanEvent || node->frameEncoder == nullptr) {
+        return false;
+    }
+    auto *message = static_cast<cclCanMessage *>(event);
+    if (message->id != node->diagConfig->RespAddr) {
+        return false;
+    }
+    uint8_t pci = node->frameEncoder->pciOffset();
+    if (message->dataLength <= pci) {
+        return false;
+    }
+    switch (message->data[pci] >> 4) {
+        case 0:
+            return singleFrame(message, pci);
+        case 1:
+            return firstFrame(message, pci);
+        case 2:
+            return consecutiveFrame(message, pci);
+        default:
+//            流控帧由 DiagTransmitter 处理
+            return false;
+    }
+}
+
+void DiagReceiver::run() {
+    if (!complete) {
+        return;
+    }
+    complete = false;
+    DiagSession *diagSession = currentSession();
+    if (diagSession != nullptr && !diagSession->isFinished()) {
+        if (node->udsClient != nullptr) {
+            node->udsClient->onResponse(diagSession, completeTime);
+        } else {
+            diagSession->responseTime = completeTime;
+            diagSession->diagSessionState = received;
+            DiagCompletion::getInstance()->notify(diagSession);
+        }
+    }
+}
+
+std::vector<uint8_t> *DiagReceiver::beginResponse(uint32_t length) {
+//    新的 SF/FF 会打断尚未完成的多帧接收
+    if (receiving) {
+        TimerScheduler::getInstance()->cancel(&receiveTimeoutTask);
+        receiving = false;
+        cclPrintf("DiagReceiver 0x%X 上一个多帧响应未完成，已被新响应打断", node->diagConfig->RespAddr);
+    }
+    if (node->udsClient != nullptr) {
+        node->udsClient->onResponseStart();
+    }
+    session = SessionTable::getInstance()->find(node->activeSessionId);
+    sessionId = node->activeSessionId;
+    target = session != nullptr ? &session->responseData : &buffer;
+//    容量不足时才重新分配，之后的连续帧只做 memcpy
+    target->resize(length);
+    offset = 0;
+    SN = 0;
+    return target;
+}
+
+bool DiagReceiver::singleFrame(cclCanMessage *message, uint8_t pci) {
+    uint32_t length = message->data[pci] & 0x0F;
+    uint8_t header = pci + 1;
+//    CAN FD 单帧：低4位为0，长度在下一个字节
+    if (length == 0 && message->dataLength > 8) {
+        length = message->data[pci + 1];
+        header = pci + 2;
+    }
+    if (length == 0 || header + length > message->dataLength) {
+        return false;
+    }
+    memcpy(beginResponse(length)->data(), message->data + header, length);
+    completeTime = message->time;
+    complete = true;
+    return true;
+}
+
+bool DiagReceiver::firstFrame(cclCanMessage *message, uint8_t pci) {
+    uint32_t length = (message->data[pci] & 0x0F) << 8 | message->data[pci + 1];
+    uint8_t header = pci + 2;
+//    超过4095字节时12位长度为0，后面4个字节为实际长度
+    if (length == 0) {
+        length = message->data[pci + 2] << 24 | message->data[pci + 3] << 16 |
+                 message->data[pci + 4] << 8 | message->data[pci + 5];
+        header = pci + 6;
+    }
+    if (header >= message->dataLength || length < static_cast<uint32_t>(message->dataLength - header)) {
+        return false;
+    }
+    if (length > node->diagConfig->maxReceiveLength) {
+        sendFlowControl(0x02);
+        DiagSession *activeSession = SessionTable::getInstance()->find(node->activeSessionId);
+        if (activeSession != nullptr) {
+            activeSession->setErrorStatus(ReceiveOverflow);
+            activeSession->diagSessionState = failed;
+            DiagCompletion::getInstance()->notify(activeSession);
+        }
+        cclPrintf("DiagReceiver 响应长度 %u 超过上限 %u", length, node->diagConfig->maxReceiveLength);
+        return false;
+    }
+    std::vector<uint8_t> *response = beginResponse(length);
+    offset = message->dataLength - header;
+    memcpy(response->data(), message->data + header, offset);
+    receiving = true;
+    blockRemaining = node->diagConfig->flowControlFrame.BS;
+    sendFlowControl(0x00);
+    TimerScheduler::getInstance()->schedule(&receiveTimeoutTask, message->time + cclTimeMilliseconds(
+            node->diagConfig->networkLayerTime.N_Cr + node->diagConfig->faultToleranceTime));
+    return false;
+}
+
+bool DiagReceiver::consecutiveFrame(cclCanMessage *message, uint8_t pci) {
+    if (!receiving) {
+        return false;
+    }
+//    会话已被释放，槽位可能已分给别的请求，丢弃剩余的连续帧
+    if (session != nullptr && currentSession() == nullptr) {
+        TimerScheduler::getInstance()->cancel(&receiveTimeoutTask);
+        receiving = false;
+        return false;
+    }
+    if ((message->data[pci] & 0x0F) != ((SN + 1) & 0x0F)) {
+        abort(WrongSequenceNumber, "DiagReceiver 连续帧序号错误");
+        return false;
+    }
+    SN++;
+    uint32_t remaining = target->size() - offset;
+    uint32_t length = message->dataLength - pci - 1;
+    length = length > remaining ? remaining : length;
+    memcpy(target->data() + offset, message->data + pci + 1, length);
+    offset += length;
+    if (offset >= target->size()) {
+        TimerScheduler::getInstance()->cancel(&receiveTimeoutTask);
+        receiving = false;
+        completeTime = message->time;
+        complete = true;
+        return true;
+    }
+//    BS 个连续帧后再回复一次流控帧
+    if (blockRemaining > 0 && --blockRemaining == 0) {
+        blockRemaining = node->diagConfig->flowControlFrame.BS;
+        sendFlowControl(0x00);
+    }
+    TimerScheduler::getInstance()->schedule(&receiveTimeoutTask, message->time + cclTimeMilliseconds(
+            node->diagConfig->networkLayerTime.N_Cr + node->diagConfig->faultToleranceTime));
+    return false;
+}
+
+void DiagReceiver::sendFlowControl(uint8_t flowStatus) {
+    FlowControlFrame flowControlFrame = node->diagConfig->flowControlFrame;
+    flowControlFrame.FS = (flowControlFrame.FS & 0xF0) | flowStatus;
+    node->frameEncoder->encodeFlowControl(&flowControlFrame, &flowControl);
+    globalVar.canBus->OutputMessage3(channel, flowControl.id, flowControl.flags, 0  // 重发次数
+            , flowControl.dataLength, flowControl.data);
+}
+
+void DiagReceiver::abort(ErrorStatus status, const char *reason) {
+    TimerScheduler::getInstance()->cancel(&receiveTimeoutTask);
+    receiving = false;
+    DiagSession *diagSession = currentSession();
+    if (diagSession != nullptr) {
+        diagSession->setErrorStatus(status);
+        diagSession->diagSessionState = failed;
+        DiagCompletion::getInstance()->notify(diagSession);
+    }
+    cclPrintf("%s", reason);
+}
+
+DiagSession *DiagReceiver::currentSession() const {
+    return session != nullptr ? SessionTable::getInstance()->find(sessionId) : nullptr;
+}
+
+ObjectPool<DiagReceiver> &DiagReceiver::pool() {
+    static ObjectPool<DiagReceiver> receiverPool;
+    return receiverPool;
+}
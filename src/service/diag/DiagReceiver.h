@@ -8,17 +8,64 @@
 
 #include "../event/EventListener.h"
 #include "../event/EventMulticaster.h"
+#include "../timer/TimerScheduler.h"
+#include "DiagCompletion.h"
 #include "../../model/entity/Node.h"
+#include "../../model/vo/ObjectPool.h"
 
+/*
+ * 诊断接收器，每个节点一个，只订阅节点的响应地址
+ * 重组 SF/FF/CF(含 CAN FD 单帧和超过4095字节的首帧)，首帧到达时按总长度一次性分配缓冲区，
+ * 按节点的 FlowControlFrame 回复流控帧，连续帧之间用 N_Cr 监控
+ * 重组完成的响应写入节点最近一次发出请求的会话，由节点的 UdsClient 按服务ID判断会话是否结束
+ * */
 class DiagReceiver : public EventListener {
 private:
     Node *node;
+    int32_t channel = -1;  // 已订阅的通道
+    bool receiving = false;  // 正在接收多帧响应
+    bool complete = false;  // 有重组完成待交付的响应
+    DiagSession *session = nullptr;  // 正在接收的会话
+    uint32_t sessionId = 0;  // 正在接收的诊断ID，会话槽位被复用后不再写入
+    std::vector<uint8_t> buffer;  // 没有会话时的接收缓冲区
+    std::vector<uint8_t> *target = nullptr;  // 本次响应写入的缓冲区
+    uint32_t offset = 0;
+    uint8_t SN = 0;
+    uint8_t blockRemaining = 0;  // 本块内还需接收的连续帧数，BS=0 时不使用
+    long long completeTime = 0;  // 响应最后一帧的时间
+    cclCanMessage flowControl = {};
+    TimerTask receiveTimeoutTask;
+
+    std::vector<uint8_t> *beginResponse(uint32_t length);
+
+//    正在接收的会话，已被释放或复用时返回空
+    DiagSession *currentSession() const;
+
+    bool singleFrame(cclCanMessage *message, uint8_t pci);
+
+    bool firstFrame(cclCanMessage *message, uint8_t pci);
+
+    bool consecutiveFrame(cclCanMessage *message, uint8_t pci);
+
+    void sendFlowControl(uint8_t flowStatus);
+
+    void abort(ErrorStatus status, const char *reason);
+
 public:
-    DiagReceiver(Node *node);
+    explicit DiagReceiver(Node *node);
+
+//    按当前测量的通道订阅响应地址，通道变化后重新订阅
+    void listen();
+
     bool onEvent(EventType type, void *event) override;
+
     void run() override;
 
+//    本次测量的接收器对象池，测量结束时统一释放
+    static ObjectPool<DiagReceiver> &pool();
+
     ~DiagReceiver() {
+        TimerScheduler::getInstance()->cancel(&receiveTimeoutTask);
         EventMulticaster::getInstance()->removeListener(this);
     }
 };
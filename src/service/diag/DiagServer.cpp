@@ -12,8 +12,64 @@ int8_t DiagServer::configAddr(uint16_t NodeHandle, uint16_t PhyAddr, uint16_t Fu
     node->diagConfig->PhyAddr = PhyAddr;
     node->diagConfig->FuncAddr = FuncAddr;
     node->diagConfig->RespAddr = RespAddr;
-//    创建接收器
-    auto *diagReceiver = new DiagReceiver(node);
+    FrameEncoderFactory::configure(node);
+    CanMessageFilter::getInstance()->addNode(node);
+//    创建接收器，重新配置地址时替换旧的接收器
+    DiagReceiver::pool().release(node->diagReceiver);
+    node->diagReceiver = DiagReceiver::pool().create(node);
+    if (node->udsClient == nullptr) {
+        node->udsClient = UdsClient::pool().create(node);
+    }
+    return 1;
+}
+
+int8_t DiagServer::configFrameFormat(uint16_t NodeHandle, uint8_t maxDLC, uint8_t paddingType, uint8_t addressingFormat,
+                                     uint8_t extendedAddress) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return 0;
+    }
+    if (maxDLC < 8 || maxDLC > 15) {
+        cclPrintf("DiagServer::configFrameFormat maxDLC=%d 超出范围8~15", maxDLC);
+        return 0;
+    }
+    Node *node = nodeMap[NodeHandle];
+    node->diagConfig->maxDLC = maxDLC;
+    node->diagConfig->paddingType = paddingType == NoPadding ? NoPadding : Padding;
+    node->diagConfig->addressingFormat = addressingFormat == ExtendedAddressing ? ExtendedAddressing : NormalAddressing;
+    node->diagConfig->extendedAddress = extendedAddress;
+    FrameEncoderFactory::configure(node);
+    return 1;
+}
+
+int8_t DiagServer::configPreSegment(uint16_t NodeHandle, uint32_t preSegmentLimit) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return 0;
+    }
+    nodeMap[NodeHandle]->diagConfig->preSegmentLimit = preSegmentLimit;
+    return 1;
+}
+
+int8_t DiagServer::configWFTmax(uint16_t NodeHandle, uint8_t WFTmax) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return 0;
+    }
+    nodeMap[NodeHandle]->diagConfig->WFTmax = WFTmax;
+    return 1;
+}
+
+int8_t DiagServer::configTxWindow(uint16_t NodeHandle, uint8_t txWindow) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end() || txWindow == 0 || txWindow > MAX_TX_WINDOW) {
+        return 0;
+    }
+    nodeMap[NodeHandle]->diagConfig->txWindow = txWindow;
+    return 1;
+}
+
+int8_t DiagServer::configBusWeight(uint16_t NodeHandle, uint8_t busWeight) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end() || busWeight == 0) {
+        return 0;
+    }
+    nodeMap[NodeHandle]->diagConfig->busWeight = busWeight;
     return 1;
 }
 
@@ -22,33 +78,178 @@ uint32_t DiagServer::sendByPhysical(uint16_t NodeHandle, uint8_t *data, uint32_t
         return 0;
     }
     Node *node = nodeMap[NodeHandle];
-    auto *parsingDTO = new DiagSession();
-    parsingDTO->data = data;
-    parsingDTO->dataLength = dataLength;
+    DiagSession *parsingDTO = acquireSession("DiagServer::sendByPhysical");
+    if (parsingDTO == nullptr) {
+        return 0;
+    }
+    parsingDTO->assignPayload(data, dataLength);
+    return submit(node, parsingDTO);
+}
+
+uint32_t DiagServer::sendReference(uint16_t NodeHandle, const uint8_t *header, uint8_t headerLength,
+                                   const uint8_t *body, uint32_t bodyLength) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end() || headerLength > REQUEST_HEADER_SIZE) {
+        return 0;
+    }
+    Node *node = nodeMap[NodeHandle];
+    DiagSession *parsingDTO = acquireSession("DiagServer::sendReference");
+    if (parsingDTO == nullptr) {
+        return 0;
+    }
+    parsingDTO->referencePayload(header, headerLength, body, bodyLength);
+    return submit(node, parsingDTO);
+}
+
+uint32_t DiagServer::submit(Node *node, DiagSession *parsingDTO) {
     parsingDTO->addressingMode = physical;
-    parsingDTO->id = DiagServer::generateDiagId(NodeHandle);
-    auto *diagTransmitter = new DiagTransmitter(parsingDTO, node);
-    diagMap.insert(std::pair<uint16_t, DiagSession *>(parsingDTO->id, parsingDTO));
-    return parsingDTO->id;
+    parsingDTO->nodeHandle = node->NodeHandle;
+    if (node->frameEncoder == nullptr) {
+        FrameEncoderFactory::configure(node);
+    }
+//    提交时整包预分帧，定时器和发送确认路径只需取下一帧
+//    引用外部数据的请求(例如 36 传输块)不预分帧，直接从引用的数据逐帧编码，不把整块再拷进帧数组
+    if (parsingDTO->headerLength == 0 && parsingDTO->dataLength <= node->diagConfig->preSegmentLimit) {
+        node->frameEncoder->encodeAll(parsingDTO, &parsingDTO->frameBatch);
+        parsingDTO->preSegmented = true;
+    }
+    UdsClient::prepare(parsingDTO);
+    attach(node, parsingDTO);
+    uint32_t diagId = parsingDTO->id;
+    DiagTransmitter::send(parsingDTO, node);
+    return diagId;
 }
 
-uint32_t DiagServer::generateDiagId(uint16_t NodeHandle) {
-    static uint32_t id;
-    static uint16_t diagId;
-    diagId++;
-    id = NodeHandle << 16 | diagId;
-    return id;
+uint32_t DiagServer::sendByFunctional(uint16_t NodeHandle, uint8_t *data, uint32_t dataLength) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return 0;
+    }
+    Node *node = nodeMap[NodeHandle];
+    if (node->frameEncoder == nullptr) {
+        FrameEncoderFactory::configure(node);
+    }
+    if (dataLength == 0 || dataLength > node->frameEncoder->maxSingleFrameLength()) {
+        cclPrintf("DiagServer::sendByFunctional 功能寻址请求只能是单帧，长度 %u 超过 %d", dataLength,
+                  node->frameEncoder->maxSingleFrameLength());
+        return 0;
+    }
+    DiagSession *request = acquireSession("DiagServer::sendByFunctional");
+    if (request == nullptr) {
+        return 0;
+    }
+//    FuncAddr 相同的节点都会收到这一帧，每个节点一个成员会话，响应由各自的接收器写入
+//    先为全部成员分配会话，任何一个分配不到就整个请求失败，不发出只有部分成员的功能请求
+    uint16_t funcAddr = node->diagConfig->FuncAddr;
+    std::vector<std::pair<Node *, DiagSession *>> members;
+    for (auto &entry: nodeMap) {
+        Node *member = entry.second;
+        if (member->diagConfig->FuncAddr != funcAddr) {
+            continue;
+        }
+        DiagSession *memberSession = acquireSession("DiagServer::sendByFunctional");
+        if (memberSession == nullptr) {
+            cclPrintf("DiagServer::sendByFunctional FuncAddr 0x%X 下有成员分配不到会话，功能请求未发出", funcAddr);
+//            已分配的会话没有发出过，直接放回空闲槽位
+            SessionTable *sessionTable = SessionTable::getInstance();
+            std::lock_guard<std::mutex> lock(DiagCompletion::getInstance()->sessionMutex());
+            members.emplace_back(node, request);
+            for (auto &acquired: members) {
+                acquired.second->diagSessionState = failed;
+                sessionTable->release(acquired.second->id);
+            }
+            return 0;
+        }
+        members.emplace_back(member, memberSession);
+    }
+    request->assignPayload(data, dataLength);
+    request->addressingMode = functional;
+    request->nodeHandle = NodeHandle;
+    UdsClient::prepare(request);
+    for (auto &member: members) {
+        DiagSession *memberSession = member.second;
+        memberSession->addressingMode = functional;
+        memberSession->nodeHandle = member.first->NodeHandle;
+        memberSession->groupId = request->id;
+        memberSession->serviceId = request->serviceId;
+        memberSession->suppressPositiveResponse = request->suppressPositiveResponse;
+        memberSession->requestTime = request->requestTime;
+        request->members.push_back(memberSession->id);
+        attach(member.first, memberSession);
+    }
+    uint32_t diagId = request->id;
+    DiagTransmitter::send(request, node);
+    return diagId;
 }
 
-int DiagServer::waitDiagComplete(uint32_t diagId) {
-    if (diagMap.find(diagId) == diagMap.end()) {
-        return -1;
+DiagSession *DiagServer::acquireSession(const char *caller) {
+    SessionTable *sessionTable = SessionTable::getInstance();
+    DiagSession *session;
+    {
+        std::lock_guard<std::mutex> lock(DiagCompletion::getInstance()->sessionMutex());
+        session = sessionTable->acquire();
+    }
+    if (session == nullptr) {
+        cclPrintf("%s 会话表已满，%d 个诊断仍在进行中", caller, sessionTable->size());
+    }
+    return session;
+}
+
+void DiagServer::attach(Node *node, DiagSession *session) {
+    if (node->frameEncoder == nullptr) {
+        FrameEncoderFactory::configure(node);
     }
-    cclPrintf("DiagServer::waitDiagComplete %x", diagId);
-    DiagSession *diagSession = diagMap[diagId];
-    while (diagSession->diagSessionState != sendComplete && diagSession->diagSessionState != sendUnfinished) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (node->diagReceiver == nullptr) {
+        node->diagReceiver = DiagReceiver::pool().create(node);
+    }
+    if (node->udsClient == nullptr) {
+        node->udsClient = UdsClient::pool().create(node);
+    }
+    node->diagReceiver->listen();
+//    上一个请求已发完、还在等响应时被新请求取代，之后的响应写入新会话，旧会话可以回收
+    SessionTable *sessionTable = SessionTable::getInstance();
+    DiagSession *previous = sessionTable->find(node->activeSessionId);
+    if (previous != nullptr && previous->diagSessionState == sendComplete) {
+        sessionTable->retire(previous);
+    }
+    node->activeSessionId = session->id;
+    node->lastActivityTime = TimerScheduler::now();
+}
+
+int DiagServer::getDiagStatus(uint32_t diagId) {
+    DiagSession *diagSession = SessionTable::getInstance()->find(diagId);
+    if (diagSession == nullptr) {
+        return -1;
     }
     return diagSession->diagSessionState;
 }
 
+int32_t DiagServer::getErrorStatus(uint32_t diagId) {
+    DiagSession *diagSession = SessionTable::getInstance()->find(diagId);
+    if (diagSession == nullptr) {
+        return -1;
+    }
+    return static_cast<int32_t>(diagSession->errorStatus);
+}
+
+int DiagServer::waitDiagComplete(uint32_t diagId) {
+    return getDiagStatus(diagId);
+}
+
+int DiagServer::waitDiagCompleteFor(uint32_t diagId, uint32_t timeoutMs) {
+    return DiagCompletion::getInstance()->waitFor(diagId, std::chrono::milliseconds(timeoutMs));
+}
+
+int32_t DiagServer::getResponse(uint32_t diagId, uint8_t *buffer, uint32_t bufferSize) {
+    DiagSession *diagSession = SessionTable::getInstance()->find(diagId);
+    if (diagSession == nullptr || diagSession->diagSessionState != received) {
+        return -1;
+    }
+    uint32_t length = diagSession->responseData.size();
+    length = length > bufferSize ? bufferSize : length;
+    memcpy(buffer, diagSession->responseData.data(), length);
+    return static_cast<int32_t>(length);
+}
+
+int8_t DiagServer::releaseDiag(uint32_t diagId) {
+    std::lock_guard<std::mutex> lock(DiagCompletion::getInstance()->sessionMutex());
+    return SessionTable::getInstance()->release(diagId) ? 1 : 0;
+}
@@ -6,25 +6,75 @@
 #define DLLTEST_DIAGSERVER_H
 
 #include "DiagTransmitter.h"
+#include "SessionTable.cpp"
+#include "DiagCompletion.cpp"
 #include "DiagTransmitter.cpp"
+#include "BusScheduler.cpp"
 #include "DiagReceiver.h"
 #include "DiagReceiver.cpp"
-
-static std::map<uint16_t, DiagSession *> diagMap = std::map<uint16_t, DiagSession *>();
+#include "../uds/UdsClient.cpp"
+#include "../uds/FunctionalGroup.cpp"
+#include "../uds/TesterPresent.cpp"
 
 class DiagServer {
 private:
-//    生成唯一的诊断ID，根据节点ID和诊断ID生成
-    static uint32_t generateDiagId(uint16_t NodeHandle);
+//    从会话表分配会话，已满时返回空
+    static DiagSession *acquireSession(const char *caller);
+
+//    按物理地址提交已填好请求数据的会话，返回诊断ID
+    static uint32_t submit(Node *node, DiagSession *parsingDTO);
+
+//    准备节点的接收器和 UDS 客户端，并把会话设为节点当前等待响应的会话
+    static void attach(Node *node, DiagSession *session);
 
 public:
 //    配置功能寻址，物理存在，响应地址
     static int8_t configAddr(uint16_t NodeHandle, uint16_t PhyAddr, uint16_t FuncAddr, uint16_t RespAddr);
 
-//    等待诊断完成
+//    配置帧格式：最大DLC、填充方式、寻址格式，配置后重新选定分帧编码器
+    static int8_t configFrameFormat(uint16_t NodeHandle, uint8_t maxDLC, uint8_t paddingType, uint8_t addressingFormat,
+                                    uint8_t extendedAddress);
+
+//    配置预分帧上限，请求长度不超过该值时在提交时整包分帧，0表示关闭
+    static int8_t configPreSegment(uint16_t NodeHandle, uint32_t preSegmentLimit);
+
+//    配置允许连续收到的 WAIT 流控帧数
+    static int8_t configWFTmax(uint16_t NodeHandle, uint8_t WFTmax);
+
+//    配置发送窗口，STmin 为0时不再逐帧等待发送确认
+    static int8_t configTxWindow(uint16_t NodeHandle, uint8_t txWindow);
+
+//    配置节点的总线权重，多个节点同时发送时按权重分配帧
+    static int8_t configBusWeight(uint16_t NodeHandle, uint8_t busWeight);
+
+//    查询诊断状态 DiagSessionState，诊断不存在时返回-1
+    static int getDiagStatus(uint32_t diagId);
+
+//    查询异常状态 ErrorStatus，诊断不存在时返回-1
+    static int32_t getErrorStatus(uint32_t diagId);
+
+//    已废弃，与 getDiagStatus 相同：CAPL 在仿真线程上调用，不能阻塞，立即返回当前状态；完成通知请用 Diag_ConfigCompletionSysVar
     static int waitDiagComplete(uint32_t diagId);
 
+//    工作线程调用，最多等待 timeoutMs 毫秒，返回当前状态，诊断不存在时返回-1
+    static int waitDiagCompleteFor(uint32_t diagId, uint32_t timeoutMs);
+
+//    返回诊断ID，由会话表分配；节点不存在或会话表已满时返回0
     static uint32_t sendByPhysical(uint16_t NodeHandle, uint8_t *data, uint32_t dataLength);
+
+//    按物理地址发送 header + body，body 不拷贝，调用方保证它在请求发完之前有效；供 DLL 内部的下载流程使用
+    static uint32_t sendReference(uint16_t NodeHandle, const uint8_t *header, uint8_t headerLength,
+                                  const uint8_t *body, uint32_t bodyLength);
+
+//    按节点的 FuncAddr 发出单帧请求，收集 FuncAddr 相同的所有节点的响应，返回功能请求的诊断ID
+//    请求超过单帧长度、节点不存在或会话表已满时返回0
+    static uint32_t sendByFunctional(uint16_t NodeHandle, uint8_t *data, uint32_t dataLength);
+
+//    读取已接收的响应，返回拷贝的字节数，尚未接收完成时返回-1
+    static int32_t getResponse(uint32_t diagId, uint8_t *buffer, uint32_t bufferSize);
+
+//    读取响应后释放诊断，槽位立即可复用，之后该诊断ID失效；诊断未结束时返回0
+    static int8_t releaseDiag(uint32_t diagId);
 };
 
 
@@ -8,40 +8,152 @@
 DiagTransmitter::DiagTransmitter(DiagSession *parsingDTO, Node *node) {
     this->parsingDTO = parsingDTO;
     this->node = node;
-    sendCondition = new SendCondition();
-    EventMulticaster::getInstance()->addListener(this);
-    DiagTransmitter::run();
+    if (node->frameEncoder == nullptr) {
+        FrameEncoderFactory::configure(node);
+    }
+    sendTimeoutTask.listener = this;
+    sendTimeoutTask.timerType = NAsTimer;
+    flowControlTimeoutTask.listener = this;
+    flowControlTimeoutTask.timerType = NBsTimer;
+    stMinTask.listener = this;
+    stMinTask.timerType = STminTimer;
+    window = node->diagConfig->txWindow == 0 ? 1 : node->diagConfig->txWindow;
+    window = window > MAX_TX_WINDOW ? MAX_TX_WINDOW : window;
+//    只订阅本会话的发送 ID(发送确认)和响应 ID(流控帧)
+    DiagConfig *diagConfig = node->diagConfig;
+    uint32_t sendId = parsingDTO->addressingMode == physical ? diagConfig->PhyAddr : diagConfig->FuncAddr;
+    EventMulticaster::getInstance()->addCanListener(this, globalVar.VIAChannel, sendId);
+    EventMulticaster::getInstance()->addCanListener(this, globalVar.VIAChannel, diagConfig->RespAddr);
+}
+
+void DiagTransmitter::send(DiagSession *parsingDTO, Node *node) {
+//    构造完成后再开始发送，发送中途结束时槽位已处于存活状态，能正常归还
+    pool().create(parsingDTO, node)->run();
+}
+
+ObjectPool<DiagTransmitter> &DiagTransmitter::pool() {
+    static ObjectPool<DiagTransmitter> transmitterPool;
+    return transmitterPool;
+}
+
+void DiagTransmitter::finish() {
+//    请求已发完或已失败，数据块立即还给池子，供后续请求复用；预分帧的帧数组也不再需要
+    parsingDTO->payload.release();
+    parsingDTO->frameBatch.release();
+    parsingDTO->data = nullptr;
+    pool().release(this);
 }
 
 void DiagTransmitter::run() {
-    if (parsingDTO->parsed) {
+    if (parsingDTO->parsed && retryFrame == nullptr) {
+//        最后几帧还在等发送确认
+        if (unconfirmedCount > 0) {
+            return;
+        }
         cclWrite("全部发送完成");
-        parsingDTO->diagSessionState = sendComplete;
-        DiagTransmitter::~DiagTransmitter();
+//        响应可能早于最后一帧的发送确认到达，已结束的会话不再回退状态
+        if (parsingDTO->diagSessionState == sendUnfinished) {
+            parsingDTO->diagSessionState = sendComplete;
+        }
+//        P2 从最后一帧的发送确认时间算起，而不是从本次回调的时间
+        long long sentTime = lastFrame != nullptr ? lastFrame->time : TimerScheduler::now();
+        if (parsingDTO->addressingMode == functional) {
+            FunctionalGroup::onRequestSent(parsingDTO, sentTime);
+        } else if (node->udsClient != nullptr) {
+            node->udsClient->onRequestSent(parsingDTO, sentTime);
+        }
+        finish();
         return;
     }
-    if (!sendCondition->isSendCondition()) {
+    if (!sendCondition.isSendCondition()) {
         return;
     }
     if (flowControlFrameCount == 0) {
-        sendCondition->flowControlFrame = false;
+        sendCondition.flowControlFrame = false;
         return;
     }
-    cclCanMessage *message = ParsingFactory::getInstance()->parse(parsingDTO, node->diagConfig);
-    if (message != nullptr) {
-        message->time = globalVar.runTime;
-        message->channel = globalVar.VIAChannel;
-        message->dir = kVIA_Tx;
-        globalVar.canBus->OutputMessage3(message->channel, message->id, message->flags, 0  // 重发次数
-                , message->dataLength, message->data);
-    }
-    sendCondition->sendSuccess = false;
-    sendCondition->stMin = false;
-    flowControlFrameCount--;
+//    由总线调度器决定何时发出，同一通道上的多个节点交替占用总线
+    BusScheduler::getInstance()->request(this);
+}
+
+void DiagTransmitter::transmit() {
+    cclCanMessage *message = retryFrame != nullptr ? retryFrame : nextFrame();
+    retryFrame = nullptr;
+    if (message == nullptr) {
+        fail(SendTimeout, "DiagTransmitter::run 分帧失败");
+        return;
+    }
+    message->time = TimerScheduler::now();
+    message->channel = globalVar.VIAChannel;
+    message->dir = kVIA_Tx;
+    VIAResult result = globalVar.canBus->OutputMessage3(message->channel, message->id, message->flags, 0  // 重发次数
+            , message->dataLength, message->data);
+    if (result != kVIA_OK) {
+//        驱动发送队列已满：保留本帧，窗口减半，等已发出的帧确认后或稍后重发
+        retryFrame = message;
+        shrinkWindow();
+        if (unconfirmedCount == 0) {
+            sendCondition.stMin = false;
+            TimerScheduler::getInstance()->schedule(&stMinTask, message->time + TX_RETRY_DELAY);
+        } else {
+            sendCondition.sendSuccess = false;
+        }
+        BusScheduler::getInstance()->release(this);
+        return;
+    }
+    unconfirmed[(unconfirmedHead + unconfirmedCount) % MAX_TX_WINDOW] = message;
+    unconfirmedCount++;
+    sendCondition.sendSuccess = unconfirmedCount < window;
+//    STmin 为0时不必等上一帧确认，窗口内可以连续交给驱动
+    sendCondition.stMin = Stmin == 0;
+    if (flowControlFrameCount > 0) {
+        flowControlFrameCount--;
+    }
     if (flowControlFrameCount == 0) {
-        sendCondition->flowControlFrame = false;
+        sendCondition.flowControlFrame = false;
     }
-    parsingDTO->sendData.push_back(message);
+//    N_As：等待最早一帧的发送确认
+    if (unconfirmedCount == 1) {
+        TimerScheduler::getInstance()->schedule(&sendTimeoutTask, message->time + cclTimeMilliseconds(
+                node->diagConfig->networkLayerTime.N_As + node->diagConfig->faultToleranceTime));
+    }
+    if (!parsingDTO->parsed && sendCondition.isSendCondition()) {
+        BusScheduler::getInstance()->request(this);
+    }
+}
+
+void DiagTransmitter::shrinkWindow() {
+    window = window > 1 ? window / 2 : 1;
+    confirmedInWindow = 0;
+}
+
+void DiagTransmitter::growWindow() {
+    if (++confirmedInWindow < window) {
+        return;
+    }
+    confirmedInWindow = 0;
+    uint8_t limit = node->diagConfig->txWindow > MAX_TX_WINDOW ? MAX_TX_WINDOW : node->diagConfig->txWindow;
+    if (window < limit) {
+        window++;
+    }
+}
+
+cclCanMessage *DiagTransmitter::nextFrame() {
+    if (!parsingDTO->preSegmented) {
+        return node->frameEncoder->encode(parsingDTO);
+    }
+//    已预分帧，只取下一帧
+    cclCanMessage *frame = parsingDTO->frameBatch.next();
+    parsingDTO->parsed = !parsingDTO->frameBatch.ready();
+    return frame;
+}
+
+void DiagTransmitter::fail(ErrorStatus status, const char *reason) {
+    parsingDTO->setErrorStatus(status);
+    parsingDTO->diagSessionState = failed;
+    DiagCompletion::getInstance()->notify(parsingDTO);
+    cclPrintf("%s", reason);
+    finish();
 }
 
 bool DiagTransmitter::onEvent(EventType type, void *event) {
@@ -49,63 +161,117 @@ bool DiagTransmitter::onEvent(EventType type, void *event) {
         case CanEvent:
             return onCanEvent(type, static_cast<cclCanMessage *>(event));
         case TimeEvent:
-            return onTimeEvent(type, *static_cast<long long int *>(event));
+            return onTimeEvent(type, static_cast<TimerEvent *>(event));
         default:
             return false;
     }
 }
 
-// 判断是否发送成功
+// 判断是否发送成功，发送确认按发送顺序匹配
 bool DiagTransmitter::sendSuccess(cclCanMessage *message) {
-    if (sendCondition->sendSuccess) {
+    uint8_t matched = unconfirmedCount;
+    for (uint8_t i = 0; i < unconfirmedCount; ++i) {
+        if (message->operator==(*unconfirmed[(unconfirmedHead + i) % MAX_TX_WINDOW])) {
+            matched = i;
+            break;
+        }
+    }
+    if (matched == unconfirmedCount) {
         return false;
     }
-    cclCanMessage lastMessage = *parsingDTO->sendData.back();
-    if (message->operator==(lastMessage)) {
-        sendCondition->sendSuccess = true;
-//        更新发送成功时间
-        parsingDTO->sendData.back()->time = message->time;
+//    匹配到的不是最早一帧，说明前面的确认丢失，一并视为已发送并缩小窗口
+    if (matched > 0) {
+        shrinkWindow();
+    } else {
+        growWindow();
+    }
+    lastFrame = unconfirmed[(unconfirmedHead + matched) % MAX_TX_WINDOW];
+//    更新发送成功时间
+    lastFrame->time = message->time;
+    unconfirmedHead = (unconfirmedHead + matched + 1) % MAX_TX_WINDOW;
+    unconfirmedCount -= matched + 1;
+    sendCondition.sendSuccess = unconfirmedCount < window && retryFrame == nullptr;
+    TimerScheduler::getInstance()->cancel(&sendTimeoutTask);
+    if (unconfirmedCount > 0) {
+        TimerScheduler::getInstance()->schedule(&sendTimeoutTask, unconfirmed[unconfirmedHead]->time +
+                cclTimeMilliseconds(node->diagConfig->networkLayerTime.N_As + node->diagConfig->faultToleranceTime));
+    }
+    for (uint8_t i = 0; i <= matched; ++i) {
+        BusScheduler::getInstance()->release(this);
+    }
+    if (retryFrame != nullptr) {
+        sendCondition.sendSuccess = true;
         return true;
     }
+    if (parsingDTO->parsed) {
+        return unconfirmedCount == 0;
+    }
+//    需要等待流控帧，N_Bs 从首帧/块内最后一帧发送成功开始计时
+    if (!sendCondition.flowControlFrame) {
+        if (unconfirmedCount > 0) {
+            return false;
+        }
+        TimerScheduler::getInstance()->schedule(&flowControlTimeoutTask, message->time + cclTimeMilliseconds(
+                node->diagConfig->networkLayerTime.N_Bs + node->diagConfig->faultToleranceTime));
+        return false;
+    }
+    return scheduleStMin();
+}
+
+bool DiagTransmitter::scheduleStMin() {
+//    流控帧可能先于首帧的发送确认到达，此时 lastFrame 为空
+    long long int lastTime = lastFrame != nullptr ? lastFrame->time : 0;
+    if (hasFlowControlFrame) {
+        lastTime = flowControlFrame.time > lastTime ? flowControlFrame.time : lastTime;
+    }
+    if (Stmin == 0) {
+        sendCondition.stMin = true;
+        return true;
+    }
+    TimerScheduler::getInstance()->schedule(&stMinTask, lastTime + Stmin);
     return false;
 }
 
 bool DiagTransmitter::waitFlowControlFrame(cclCanMessage *message) {
-    if (sendCondition->flowControlFrame) {
+    if (sendCondition.flowControlFrame) {
         return false;
     }
     if (message->id != node->diagConfig->RespAddr) {
         return false;
     }
-    if ((message->data[0] & 0xF0) != 0x30) {
+//    扩展寻址时第0字节为源地址，PCI 后移一个字节
+    uint8_t pci = node->diagConfig->addressingFormat == ExtendedAddressing ? 1 : 0;
+    if ((message->data[pci] & 0xF0) != 0x30) {
         return false;
     }
-    int flowControlStatus = message->data[0] & 0x0F;
-    flowControlFrame = std::make_shared<cclCanMessage>(*message);
+    int flowControlStatus = message->data[pci] & 0x0F;
+    flowControlFrame = *message;
+    hasFlowControlFrame = true;
+    TimerScheduler::getInstance()->cancel(&flowControlTimeoutTask);
     if (flowControlStatus == 0) {
-        sendCondition->flowControlFrame = true;
-        sendCondition->stMin = false;
-        flowControlFrameCount = message->data[1];
-        Stmin = message->data[2];
-        return true;
+        sendCondition.flowControlFrame = true;
+        sendCondition.stMin = false;
+//        BS=0 表示后续连续帧不再等待流控帧
+        flowControlFrameCount = message->data[pci + 1] == 0 ? -1 : message->data[pci + 1];
+        waitFrameCount = 0;
+        Stmin = decodeSTmin(message->data[pci + 2]);
+        return scheduleStMin();
     }
     if (flowControlStatus == 1) {
-        sendCondition->flowControlFrame = false;
-//        TODO 暂时不做处理,等以后再说
-        cclPrintf("流控帧状态为等待,暂时不做处理!!!");
-        parsingDTO->setErrorStatus(flowControlOverflow);
-        DiagTransmitter::~DiagTransmitter();
+//        等待：连续 WAIT 不超过 WFTmax 时重新开始 N_Bs，继续等待下一个流控帧
+        if (++waitFrameCount > node->diagConfig->WFTmax) {
+            fail(WaitFrameOverflow, "连续等待流控帧超过 WFTmax");
+            return false;
+        }
+        TimerScheduler::getInstance()->schedule(&flowControlTimeoutTask, message->time + cclTimeMilliseconds(
+                node->diagConfig->networkLayerTime.N_Bs + node->diagConfig->faultToleranceTime));
         return false;
     }
     if (flowControlStatus == 2) {
-        parsingDTO->setErrorStatus(flowControlOverflow);
-        cclPrintf("流控帧溢出");
-        DiagTransmitter::~DiagTransmitter();
+        fail(flowControlOverflow, "流控帧溢出");
         return false;
     }
-    parsingDTO->setErrorStatus(FlowControlError);
-    cclPrintf("异常流控帧");
-    DiagTransmitter::~DiagTransmitter();
+    fail(FlowControlError, "异常流控帧");
     return false;
 }
 
@@ -117,66 +283,43 @@ bool DiagTransmitter::onCanEvent(EventType type, cclCanMessage *message) {
 }
 
 // ========================================================================
-bool DiagTransmitter::sendTimeout(long long int time) {
-    if (sendCondition->sendSuccess) {
+// 以下超时处理只在对应截止时间到期时由 TimerScheduler 回调
+bool DiagTransmitter::sendTimeout(long long int) {
+    if (unconfirmedCount == 0) {
         return false;
     }
-    long long int lastTime = parsingDTO->sendData.back()->time;
-//    错误状态与SendTimeout做异或操作，如果为0则说明没有超时
-    if ((parsingDTO->errorStatus ^ SendTimeout) == 0 &&
-        time - lastTime >= cclTimeMilliseconds(node->diagConfig->networkLayerTime->N_As)) {
-        parsingDTO->errorStatus = parsingDTO->errorStatus | SendTimeout;
-    }
-    if (time - lastTime >=
-        cclTimeMilliseconds(node->diagConfig->networkLayerTime->N_As + node->diagConfig->faultToleranceTime)) {
-        sendCondition->sendSuccess = false;
-        parsingDTO->setErrorStatus(SendTimeout);
-        cclPrintf("发送失败，发送超时");
-        DiagTransmitter::~DiagTransmitter();
-    }
+    fail(SendTimeout, "发送失败，发送超时");
     return false;
 }
 
-bool DiagTransmitter::waitFlowControlFrameTimeout(long long int time) {
-    if (sendCondition->flowControlFrame) {
+bool DiagTransmitter::waitFlowControlFrameTimeout(long long int) {
+    if (sendCondition.flowControlFrame) {
         return false;
     }
-    long long int N_Bs = cclTimeMilliseconds(node->diagConfig->networkLayerTime->N_Bs);
-    if ((parsingDTO->errorStatus ^ BsTimeout) == 0 && time - parsingDTO->sendData.back()->time > N_Bs) {
-        parsingDTO->errorStatus = parsingDTO->errorStatus | BsTimeout;
-    }
-    if ((time - parsingDTO->sendData.back()->time) > (N_Bs + node->diagConfig->faultToleranceTime)) {
-        parsingDTO->setErrorStatus(BsTimeout);
-        cclPrintf("DiagTransmitter::waitFlowControlFrameTimeout   未接收到流控帧");
-        DiagTransmitter::~DiagTransmitter();
-        return true;
-    }
+    fail(BsTimeout, "DiagTransmitter::waitFlowControlFrameTimeout   未接收到流控帧");
     return false;
 }
 
-bool DiagTransmitter::stMinTimeout(long long int time) {
-    if (sendCondition->stMin) {
+bool DiagTransmitter::stMinTimeout(long long int) {
+    if (sendCondition.stMin) {
         return false;
     }
-    long long int stmin = cclTimeMilliseconds(Stmin);
-    long long int lastTime = parsingDTO->sendData.back()->time;
-    if (flowControlFrame != nullptr) {
-        lastTime = flowControlFrame->time > lastTime ? flowControlFrame->time : lastTime;
-    }
-    if (time - lastTime > stmin) {
-        sendCondition->stMin = true;
-        return true;
-    }
-    return false;
+    sendCondition.stMin = true;
+    return true;
 }
 
-bool DiagTransmitter::onTimeEvent(EventType type, long long int time) {
+bool DiagTransmitter::onTimeEvent(EventType type, TimerEvent *timerEvent) {
     if (type != TimeEvent) {
         return false;
     }
-    sendTimeout(time);
-    return stMinTimeout(time) || waitFlowControlFrameTimeout(time);
+    switch (timerEvent->timerType) {
+        case NAsTimer:
+            return sendTimeout(timerEvent->time);
+        case NBsTimer:
+            return waitFlowControlFrameTimeout(timerEvent->time);
+        case STminTimer:
+            return stMinTimeout(timerEvent->time);
+        default:
+            return false;
+    }
 }
-
-
-
@@ -7,9 +7,23 @@
 
 #include "DiagParsing.h"
 #include "DiagParsing.cpp"
+#include "FrameEncoder.h"
+#include "FrameEncoder.cpp"
+#include "BusScheduler.h"
+#include "DiagCompletion.h"
+#include "../uds/UdsClient.h"
 #include "../event/EventListener.h"
 #include "../event/EventMulticaster.h"
+#include "../timer/TimerScheduler.h"
 #include "../../model/entity/Node.h"
+#include "../../model/vo/ObjectPool.h"
+
+// 发送窗口上限，已发出未确认的帧必须仍在会话的 FrameRing 中
+#define MAX_TX_WINDOW 8
+static_assert(MAX_TX_WINDOW < SESSION_FRAME_RING_SIZE, "发送窗口必须小于会话帧环容量");
+
+// 驱动发送队列已满时重试的间隔
+#define TX_RETRY_DELAY cclTimeMicroseconds(100)
 
 /*
  * 诊断发送器，构造函数中传入诊断数据，然后进行发送，
@@ -22,7 +36,7 @@ private:
 
 // 是否满足发送条件
     struct SendCondition {
-        bool sendSuccess = true;//    上一帧发送成功
+        bool sendSuccess = true;//    发送窗口未满(窗口为1时即上一帧发送成功)
         bool stMin = true;//        STmin 连续帧间隔 满足
         bool delayTime = true; //        延时时间满足
         bool flowControlFrame = true;
@@ -36,17 +50,60 @@ private:
         }
     };
 
-//  距离下一次等待流控帧还差几帧
+//  距离下一次等待流控帧还差几帧，-1 表示 BS=0，不再等待流控帧
     int flowControlFrameCount = 1;
-    uint8_t Stmin = 0;
-    std::shared_ptr<cclCanMessage> flowControlFrame = nullptr;
+    long long Stmin = 0;  // 已解码的连续帧间隔，单位纳秒
+//    连续收到的 WAIT 流控帧数，收到 CTS 后清零；比 WFTmax 宽，WFTmax=255 时不会回绕
+    uint16_t waitFrameCount = 0;
+//    最近一次收到的流控帧，按值保存，避免每个流控帧一次堆申请
+    cclCanMessage flowControlFrame = {};
+    bool hasFlowControlFrame = false;
+
+//    最近一次确认发送成功的帧，位于会话的 FrameRing 或预分帧数组中
+    cclCanMessage *lastFrame = nullptr;
+
+//    已交给驱动、尚未收到发送确认的帧，按发送顺序排列
+    cclCanMessage *unconfirmed[MAX_TX_WINDOW] = {};
+    uint8_t unconfirmedHead = 0;
+    uint8_t unconfirmedCount = 0;
+//    发送窗口：乱序确认或驱动拒绝发送时减半，连续确认满一个窗口后加一，不超过节点的 txWindow
+    uint8_t window = 1;
+    uint8_t confirmedInWindow = 0;
+//    驱动拒绝发送的帧，下次发送时优先重发
+    cclCanMessage *retryFrame = nullptr;
 
     DiagSession *parsingDTO;
     Node *node;
-    SendCondition *sendCondition;
+    SendCondition sendCondition;
+
+//    N_As、N_Bs、STmin 截止时间，由 TimerScheduler 在到期时回调
+    TimerTask sendTimeoutTask;
+    TimerTask flowControlTimeoutTask;
+    TimerTask stMinTask;
+
+//    总线调度状态，由 BusScheduler 维护
+    bool queued = false;
+    uint8_t inFlight = 0;
+    uint64_t busPass = 0;
+
+//    取下一帧：预分帧时直接取数组中的下一帧，否则逐帧编码
+    cclCanMessage *nextFrame();
+
+    void shrinkWindow();
+
+    void growWindow();
+
+//    发送失败，记录异常状态并结束发送
+    void fail(ErrorStatus status, const char *reason);
+
+//    发送结束，析构并把槽位归还对象池，调用后不能再访问成员
+    void finish();
 
     bool sendSuccess(cclCanMessage *message);
 
+//    按 STmin 安排下一帧，STmin 为0时直接返回 true
+    bool scheduleStMin();
+
     bool waitFlowControlFrame(cclCanMessage *message);
 
     bool onCanEvent(EventType type, cclCanMessage *message);
@@ -57,16 +114,31 @@ private:
 
     bool waitFlowControlFrameTimeout(long long time);
 
-    bool onTimeEvent(EventType type, long long time);
+    bool onTimeEvent(EventType type, TimerEvent *timerEvent);
+
+//    BusScheduler 分到名额后调用，发送下一帧
+    void transmit();
+
+    friend class BusScheduler;
 
 public:
     explicit DiagTransmitter(DiagSession *parsingDTO, Node *node);
 
+//    从对象池创建发送器并开始发送，发送结束后发送器自行归还槽位
+    static void send(DiagSession *parsingDTO, Node *node);
+
+//    本次测量的发送器对象池，测量结束时统一释放
+    static ObjectPool<DiagTransmitter> &pool();
+
     bool onEvent(EventType type, void *event) override;
 
     void run() override;
 
     ~DiagTransmitter() {
+        TimerScheduler::getInstance()->cancel(&sendTimeoutTask);
+        TimerScheduler::getInstance()->cancel(&flowControlTimeoutTask);
+        TimerScheduler::getInstance()->cancel(&stMinTask);
+        BusScheduler::getInstance()->remove(this);
         EventMulticaster::getInstance()->removeListener(this);
     }
 };
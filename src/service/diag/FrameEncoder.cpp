@@ -0,0 +1,28 @@
+﻿#include "FrameEncoder.h"
+
+void FrameEncoderFactory::configure(Node *node) {
+    static constexpr auto normalPadding = creators<Padding, NormalAddressing>(std::make_index_sequence<8>());
+    static constexpr auto normalNoPadding = creators<NoPadding, NormalAddressing>(std::make_index_sequence<8>());
+    static constexpr auto extendedPadding = creators<Padding, ExtendedAddressing>(std::make_index_sequence<8>());
+    static constexpr auto extendedNoPadding = creators<NoPadding, ExtendedAddressing>(std::make_index_sequence<8>());
+
+    DiagConfig *diagConfig = node->diagConfig;
+    if (diagConfig->maxDLC < 8 || diagConfig->maxDLC > 15) {
+        cclPrintf("%s %d: maxDLC=%d 超出范围，按8处理", __func__, __LINE__, diagConfig->maxDLC);
+        diagConfig->maxDLC = 8;
+    }
+//    超过8字节的帧必须是 CAN FD 帧
+    if (diagConfig->maxDLC > 8) {
+        diagConfig->canMessageConfig.FDF = true;
+    }
+    uint32_t flags = createFlag(diagConfig->canMessageConfig);
+    uint8_t index = diagConfig->maxDLC - 8;
+    Creator creator;
+    if (diagConfig->addressingFormat == ExtendedAddressing) {
+        creator = diagConfig->paddingType == Padding ? extendedPadding[index] : extendedNoPadding[index];
+    } else {
+        creator = diagConfig->paddingType == Padding ? normalPadding[index] : normalNoPadding[index];
+    }
+    delete node->frameEncoder;
+    node->frameEncoder = creator(diagConfig, flags);
+}
@@ -0,0 +1,234 @@
+#ifndef DLLTEST_FRAMEENCODER_H
+#define DLLTEST_FRAMEENCODER_H
+
+#include <array>
+#include <utility>
+#include "../../model/vo/DiagV0.h"
+#include "../../model/entity/Node.h"
+
+// DLC -> 帧实际字节数，编译期常量，替代 DLC_ActualLength 的 map 查找
+constexpr std::array<uint8_t, 16> DLC_FRAME_LENGTH = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+
+// 需要的字节数 -> 能容纳它的最小合法帧长度(0~64)
+constexpr std::array<uint8_t, 65> FRAME_LENGTH_ROUND_UP = [] {
+    std::array<uint8_t, 65> table{};
+    uint8_t dlc = 0;
+    for (uint8_t length = 0; length <= 64; ++length) {
+        while (DLC_FRAME_LENGTH[dlc] < length) {
+            dlc++;
+        }
+        table[length] = DLC_FRAME_LENGTH[dlc];
+    }
+    return table;
+}();
+
+// 流控帧 STmin 字节 -> 连续帧间隔，单位纳秒
+// 0x00~0x7F 为 0~127ms，0xF1~0xF9 为 100~900us，其余为保留值，按 ISO 15765-2 视为 0x7F
+constexpr long long decodeSTmin(uint8_t STmin) {
+    if (STmin <= 0x7F) {
+        return STmin * 1000000LL;
+    }
+    if (STmin >= 0xF1 && STmin <= 0xF9) {
+        return (STmin - 0xF0) * 100000LL;
+    }
+    return 0x7F * 1000000LL;
+}
+
+static_assert(decodeSTmin(0xF1) == 100000LL && decodeSTmin(0x7F) == 127000000LL && decodeSTmin(0x80) == 127000000LL);
+
+/*
+ * FrameEncoder  分帧编码器
+ * 节点配置时根据帧格式选定一个模板实例，之后每一帧只有一次虚调用，不再走 ParsingFactory 的 isSupport 遍历
+ * 生成的帧写入会话的 FrameRing 槽位
+ * */
+class FrameEncoder {
+public:
+//    逐帧编码，帧写入会话的 FrameRing
+    virtual cclCanMessage *encode(DiagSession *session) = 0;
+
+//    整包预分帧，SF 或 FF + 全部 CF 写入连续的 frameBatch，不修改会话的分帧游标，返回帧数
+    virtual uint32_t encodeAll(const DiagSession *session, FrameBatch *frameBatch) = 0;
+
+//    不经过会话直接编码一个单帧，用于 TesterPresent 这类固定的短请求；dataLength 不能超过单帧长度
+    virtual void encodeSingleFrame(const uint8_t *data, uint8_t dataLength, AddressingMode addressingMode,
+                                   cclCanMessage *frame) = 0;
+
+//    接收多帧响应时使用的流控帧，按物理地址发送
+    virtual void encodeFlowControl(const FlowControlFrame *flowControlFrame, cclCanMessage *frame) = 0;
+
+//    接收方向 PCI 在数据中的起始位置
+    [[nodiscard]] virtual uint8_t pciOffset() const = 0;
+
+//    单帧可容纳的最大数据长度，功能寻址请求只能用单帧
+    [[nodiscard]] virtual uint8_t maxSingleFrameLength() const = 0;
+
+    virtual ~FrameEncoder() = default;
+};
+
+template<uint8_t MaxDLC, PaddingType Pad, AddressingFormat Addr>
+class IsoTpFrameEncoder : public FrameEncoder {
+    static_assert(MaxDLC >= 8 && MaxDLC <= 15, "MaxDLC 取值范围为8~15");
+private:
+//    PCI 在数据中的起始位置，扩展寻址时第0字节为 N_TA
+    static constexpr uint8_t PCI = Addr == ExtendedAddressing ? 1 : 0;
+    static constexpr uint8_t FRAME_LENGTH = DLC_FRAME_LENGTH[MaxDLC];
+//    单帧可容纳的最大数据长度，CAN FD 超过8字节时 PCI 为 0x00 + 长度字节
+    static constexpr uint8_t SF_MAX_LENGTH = FRAME_LENGTH == 8 ? 7 - PCI : FRAME_LENGTH - 2 - PCI;
+    static constexpr uint8_t CF_DATA_LENGTH = FRAME_LENGTH - 1 - PCI;
+
+//    预先生成的帧头模板：id、flags、扩展地址以及填充字节
+    cclCanMessage physicalTemplate = {};
+    cclCanMessage functionalTemplate = {};
+
+//    按填充方式得到最终帧长度
+    static constexpr uint8_t frameLength(uint32_t needLength) {
+        if (needLength <= 8) {
+            return Pad == Padding ? 8 : static_cast<uint8_t>(needLength);
+        }
+        return FRAME_LENGTH_ROUND_UP[needLength];
+    }
+
+    const cclCanMessage &frameTemplate(const DiagSession *session) const {
+        return session->addressingMode == physical ? physicalTemplate : functionalTemplate;
+    }
+
+//    在已填好帧头模板的 frame 上编码一帧，offset/SN 为分帧游标
+    static void encodeFrame(const RequestView &request, uint32_t dataLength, uint32_t &offset, uint8_t &SN,
+                            cclCanMessage *frame) {
+//        单帧
+        if (offset == 0 && dataLength <= SF_MAX_LENGTH) {
+            uint8_t header;
+            if (dataLength <= 7 - PCI) {
+                frame->data[PCI] = dataLength;
+                header = PCI + 1;
+            } else {
+                frame->data[PCI] = 0x00;
+                frame->data[PCI + 1] = dataLength;
+                header = PCI + 2;
+            }
+            request.copy(0, frame->data + header, dataLength);
+            frame->dataLength = frameLength(header + dataLength);
+            offset = dataLength;
+            return;
+        }
+//        首帧
+        if (offset == 0) {
+            uint8_t header;
+            if (dataLength <= 4095) {
+                frame->data[PCI] = 0x10 | (dataLength >> 8);
+                frame->data[PCI + 1] = dataLength & 0xFF;
+                header = PCI + 2;
+            } else {
+                frame->data[PCI] = 0x10;
+                frame->data[PCI + 1] = 0x00;
+                frame->data[PCI + 2] = (dataLength >> 24) & 0xFF;
+                frame->data[PCI + 3] = (dataLength >> 16) & 0xFF;
+                frame->data[PCI + 4] = (dataLength >> 8) & 0xFF;
+                frame->data[PCI + 5] = dataLength & 0xFF;
+                header = PCI + 6;
+            }
+            request.copy(0, frame->data + header, FRAME_LENGTH - header);
+            frame->dataLength = FRAME_LENGTH;
+            offset = FRAME_LENGTH - header;
+            return;
+        }
+//        连续帧
+        uint32_t remaining = dataLength - offset;
+        uint8_t length = remaining > CF_DATA_LENGTH ? CF_DATA_LENGTH : static_cast<uint8_t>(remaining);
+        frame->data[PCI] = 0x20 | (++SN & 0x0F);
+        request.copy(offset, frame->data + PCI + 1, length);
+        frame->dataLength = frameLength(PCI + 1 + length);
+        offset += length;
+    }
+
+public:
+    explicit IsoTpFrameEncoder(const DiagConfig *diagConfig, uint32_t flags) {
+        physicalTemplate.id = diagConfig->PhyAddr;
+        physicalTemplate.flags = flags;
+        memset(physicalTemplate.data, diagConfig->paddingData, sizeof(physicalTemplate.data));
+        if (Addr == ExtendedAddressing) {
+            physicalTemplate.data[0] = diagConfig->extendedAddress;
+        }
+        functionalTemplate = physicalTemplate;
+        functionalTemplate.id = diagConfig->FuncAddr;
+    }
+
+    cclCanMessage *encode(DiagSession *session) override {
+        if (session->parsed) {
+            return nullptr;
+        }
+        cclCanMessage *frame = session->sendData.acquire();
+        *frame = frameTemplate(session);
+        encodeFrame(session->request(), session->dataLength, session->offset, session->SN, frame);
+        session->parsed = session->offset >= session->dataLength;
+        return frame;
+    }
+
+    uint32_t encodeAll(const DiagSession *session, FrameBatch *frameBatch) override {
+        uint32_t dataLength = session->dataLength;
+        uint32_t frameCount = 1;
+        if (dataLength > SF_MAX_LENGTH) {
+            uint32_t firstLength = FRAME_LENGTH - PCI - (dataLength <= 4095 ? 2 : 6);
+            frameCount += (dataLength - firstLength + CF_DATA_LENGTH - 1) / CF_DATA_LENGTH;
+        }
+        frameBatch->reset(frameCount);
+//        整包一次性顺序编码：模板拷贝 + PCI + 连续 memcpy，不经过会话的分帧游标
+        const cclCanMessage &header = frameTemplate(session);
+        RequestView request = session->request();
+        cclCanMessage *frames = frameBatch->frames.data();
+        uint32_t offset = 0;
+        uint8_t SN = 0;
+        for (uint32_t i = 0; i < frameCount; ++i) {
+            frames[i] = header;
+            encodeFrame(request, dataLength, offset, SN, &frames[i]);
+        }
+        return frameCount;
+    }
+
+    void encodeSingleFrame(const uint8_t *data, uint8_t dataLength, AddressingMode addressingMode,
+                           cclCanMessage *frame) override {
+        *frame = addressingMode == physical ? physicalTemplate : functionalTemplate;
+        uint32_t offset = 0;
+        uint8_t SN = 0;
+        encodeFrame({nullptr, 0, data}, dataLength, offset, SN, frame);
+    }
+
+    void encodeFlowControl(const FlowControlFrame *flowControlFrame, cclCanMessage *frame) override {
+        *frame = physicalTemplate;
+        frame->data[PCI] = flowControlFrame->FS;
+        frame->data[PCI + 1] = flowControlFrame->BS;
+        frame->data[PCI + 2] = flowControlFrame->STmin;
+        frame->dataLength = frameLength(PCI + 3);
+    }
+
+    [[nodiscard]] uint8_t pciOffset() const override {
+        return PCI;
+    }
+
+    [[nodiscard]] uint8_t maxSingleFrameLength() const override {
+        return SF_MAX_LENGTH;
+    }
+};
+
+class FrameEncoderFactory {
+private:
+    typedef FrameEncoder *(*Creator)(const DiagConfig *diagConfig, uint32_t flags);
+
+    template<uint8_t MaxDLC, PaddingType Pad, AddressingFormat Addr>
+    static FrameEncoder *create(const DiagConfig *diagConfig, uint32_t flags) {
+        return new IsoTpFrameEncoder<MaxDLC, Pad, Addr>(diagConfig, flags);
+    }
+
+//    编译期生成 MaxDLC(8~15) x 填充方式 x 寻址格式 的构造函数表
+    template<PaddingType Pad, AddressingFormat Addr, size_t... I>
+    static constexpr std::array<Creator, sizeof...(I)> creators(std::index_sequence<I...>) {
+        return {&create<static_cast<uint8_t>(I + 8), Pad, Addr>...};
+    }
+
+public:
+//    根据节点当前配置重新选定编码器，节点地址或帧格式变化时调用
+    static void configure(Node *node);
+};
+
+
+#endif //DLLTEST_FRAMEENCODER_H
@@ -0,0 +1,85 @@
+﻿#include "SessionTable.h"
+
+SessionTable::SessionTable() {
+    slots = new Slot[SESSION_TABLE_SIZE];
+    clear();
+}
+
+void SessionTable::clear() {
+    freeCount = 0;
+    retiredHead = 0;
+    retiredCount = 0;
+    usedCount = 0;
+//    倒序入栈，先分配下标小的槽位；代数保留，上次测量的诊断ID不会与新ID相同
+    for (uint32_t i = 0; i < SESSION_TABLE_SIZE; ++i) {
+        Slot &slot = slots[SESSION_TABLE_SIZE - 1 - i];
+        slot.used = false;
+        slot.retired = false;
+        slot.session.reset();
+        slot.session.payload.release();
+        std::vector<uint8_t>().swap(slot.session.responseData);
+        std::vector<cclCanMessage>().swap(slot.session.frameBatch.frames);
+        freeSlots[freeCount++] = SESSION_TABLE_SIZE - 1 - i;
+    }
+}
+
+DiagSession *SessionTable::acquire() {
+    uint32_t index;
+    if (freeCount > 0) {
+        index = freeSlots[--freeCount];
+    } else if (retiredCount > 0) {
+        index = retiredSlots[retiredHead];
+        retiredHead = (retiredHead + 1) & SLOT_MASK;
+        retiredCount--;
+    } else {
+        return nullptr;
+    }
+    Slot &slot = slots[index];
+    if (!slot.used) {
+        usedCount++;
+    }
+//    代数不为0，保证诊断ID不为0，0 表示请求失败
+    slot.generation = slot.generation >= MAX_GENERATION ? 1 : slot.generation + 1;
+    slot.used = true;
+    slot.retired = false;
+    slot.session.reset();
+    slot.session.id = slot.generation << SESSION_SLOT_BITS | index;
+    return &slot.session;
+}
+
+void SessionTable::retire(DiagSession *session) {
+    uint32_t index = slotOf(session->id);
+    Slot &slot = slots[index];
+    if (&slot.session != session || !slot.used || slot.retired) {
+        return;
+    }
+    slot.retired = true;
+//    槽位出队前 retired 一直为真，每个槽位最多在队列中出现一次，队列不会溢出
+    retiredSlots[(retiredHead + retiredCount) & SLOT_MASK] = index;
+    retiredCount++;
+}
+
+bool SessionTable::release(uint32_t diagId) {
+    DiagSession *session = find(diagId);
+    if (session == nullptr || !session->isFinished()) {
+        return false;
+    }
+    uint32_t index = slotOf(diagId);
+    Slot &slot = slots[index];
+//    终态会话都已退役，先从回收队列中摘除，保持每个槽位只在空闲栈或回收队列之一
+    if (slot.retired) {
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < retiredCount; ++i) {
+            uint16_t retiredIndex = retiredSlots[(retiredHead + i) & SLOT_MASK];
+            if (retiredIndex != index) {
+                retiredSlots[(retiredHead + kept++) & SLOT_MASK] = retiredIndex;
+            }
+        }
+        retiredCount = kept;
+        slot.retired = false;
+    }
+    slot.used = false;
+    usedCount--;
+    freeSlots[freeCount++] = index;
+    return true;
+}
@@ -0,0 +1,83 @@
+﻿#ifndef DLLTEST_SESSIONTABLE_H
+#define DLLTEST_SESSIONTABLE_H
+
+#include "../../model/vo/DiagV0.h"
+
+// 会话表槽位数，句柄低 SESSION_SLOT_BITS 位为槽位下标
+#define SESSION_SLOT_BITS 10
+#define SESSION_TABLE_SIZE (1u << SESSION_SLOT_BITS)
+
+/*
+ * SessionTable  诊断会话表
+ * 启动时一次性申请 SESSION_TABLE_SIZE 个会话槽位，之后只复用槽位，内存不随请求数增长
+ * 诊断ID(句柄) = 代数 << SESSION_SLOT_BITS | 槽位下标，按下标 O(1) 定位，代数不一致说明槽位已被复用，查找返回空；
+ * 代数限制在 21 位以内，CAPL 按有符号 long 读取的诊断ID始终为正数
+ * 会话进入终态或被同节点的新请求取代后才进入回收队列；分配时先用空闲槽位，没有时回收最早退役的会话，
+ * 所以终态会话在被复用前仍可读取响应；Diag_ReleaseDiag 把槽位移出回收队列直接放回空闲槽位
+ * */
+class SessionTable {
+private:
+    typedef struct Slot {
+        DiagSession session;
+        uint32_t generation = 0;
+        bool used = false;
+        bool retired = false;  // 在回收队列中
+    } Slot;
+
+    static constexpr uint32_t SLOT_MASK = SESSION_TABLE_SIZE - 1;
+    static constexpr uint32_t MAX_GENERATION = INT32_MAX >> SESSION_SLOT_BITS;
+
+    Slot *slots;
+//    空闲槽位栈
+    uint16_t freeSlots[SESSION_TABLE_SIZE];
+    uint32_t freeCount = 0;
+//    回收队列，按退役顺序复用
+    uint16_t retiredSlots[SESSION_TABLE_SIZE];
+    uint32_t retiredHead = 0;
+    uint32_t retiredCount = 0;
+    uint32_t usedCount = 0;
+
+    SessionTable();
+
+    [[nodiscard]] static uint32_t slotOf(uint32_t diagId) {
+        return diagId & SLOT_MASK;
+    }
+
+public:
+    static SessionTable *getInstance() {
+        static SessionTable *instance = nullptr;
+        if (instance == nullptr) {
+            instance = new SessionTable();
+        }
+        return instance;
+    }
+
+//    分配一个已清空的会话并写入新的诊断ID，槽位全部在用时返回空
+    DiagSession *acquire();
+
+//    按诊断ID查找，不存在或槽位已被复用时返回空
+    [[nodiscard]] DiagSession *find(uint32_t diagId) const {
+        const Slot &slot = slots[slotOf(diagId)];
+        if (!slot.used || slot.generation != diagId >> SESSION_SLOT_BITS) {
+            return nullptr;
+        }
+        return const_cast<DiagSession *>(&slot.session);
+    }
+
+//    会话不会再被发送器或接收器写入，允许之后被复用，重复调用无影响
+    void retire(DiagSession *session);
+
+//    立即释放终态会话，槽位从回收队列移回空闲槽位，下一次分配优先复用；会话仍在发送或等待响应时返回 false
+    bool release(uint32_t diagId);
+
+//    测量结束时释放全部会话，之前的诊断ID全部失效，并归还请求块和响应缓冲区占用的内存
+    void clear();
+
+//    使用中的会话数
+    [[nodiscard]] uint32_t size() const {
+        return usedCount;
+    }
+};
+
+
+#endif //DLLTEST_SESSIONTABLE_H
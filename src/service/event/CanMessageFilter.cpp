@@ -0,0 +1,95 @@
+﻿#include "CanMessageFilter.h"
+
+void CanMessageFilter::onIdMessage(cclCanMessage *message) {
+    instance->handler(message);
+}
+
+void CanMessageFilter::onAllMessage(cclCanMessage *message) {
+    if (!instance->allMessages || instance->registered.count(message->id) != 0) {
+        return;
+    }
+    instance->handler(message);
+}
+
+bool CanMessageFilter::registerId(uint32_t id) {
+    if (registered.count(id) != 0) {
+        return true;
+    }
+    int32_t result = cclCanSetMessageHandler(channel, id, &CanMessageFilter::onIdMessage);
+    if (result != CCL_SUCCESS) {
+        cclPrintf("CanMessageFilter::registerId 注册 ID 0x%X 失败 %d", id, result);
+        return false;
+    }
+    registered.insert(id);
+    return true;
+}
+
+void CanMessageFilter::passUnregistered(const char *reason) {
+    if (allMessages) {
+        return;
+    }
+    allMessages = true;
+    cclPrintf("CanMessageFilter 全部报文回调开始转发未注册的 ID: %s", reason);
+}
+
+void CanMessageFilter::install(int32_t channel, CanMessageHandler handler) {
+    this->channel = channel;
+    this->handler = handler;
+    installed = true;
+    allMessages = false;
+    registered.clear();
+    int32_t result = cclCanSetMessageHandler(channel, CCL_CAN_ALLMESSAGES, &CanMessageFilter::onAllMessage);
+    allInstalled = result == CCL_SUCCESS;
+    if (!allInstalled) {
+        cclPrintf("CanMessageFilter::install 注册全部报文回调失败 %d", result);
+    }
+    if (!enabled) {
+        passUnregistered("按 ID 注册已关闭");
+        return;
+    }
+    for (auto &item: nodeMap) {
+        DiagConfig *diagConfig = item.second->diagConfig;
+        if (!registerId(diagConfig->PhyAddr) || !registerId(diagConfig->FuncAddr) ||
+            !registerId(diagConfig->RespAddr)) {
+            passUnregistered("ID 注册失败");
+            return;
+        }
+    }
+    if (registered.empty()) {
+        passUnregistered("没有已配置的节点");
+        return;
+    }
+    cclPrintf("CanMessageFilter 已按 ID 注册 %d 个报文回调", static_cast<int>(registered.size()));
+}
+
+void CanMessageFilter::addNode(Node *node) {
+    if (!installed || allMessages) {
+        return;
+    }
+    DiagConfig *diagConfig = node->diagConfig;
+    uint32_t ids[] = {diagConfig->PhyAddr, diagConfig->FuncAddr, diagConfig->RespAddr};
+    for (uint32_t id: ids) {
+        if (registered.count(id) != 0) {
+            continue;
+        }
+//        测量开始后 CCL 不再接受注册，新 ID 只能由 PreStart 时注册的全部报文回调接收；节点跨测量保留，下一次测量开始时按 ID 注册
+        if (allInstalled) {
+            passUnregistered("测量开始后新增了诊断 ID");
+        } else {
+            cclPrintf("CanMessageFilter::addNode 全部报文回调未注册，ID 0x%X 本次测量收不到", id);
+        }
+        return;
+    }
+}
+
+void CanMessageFilter::reset() {
+    installed = false;
+    allInstalled = false;
+    allMessages = false;
+    registered.clear();
+}
+
+int8_t CanMessageFilter::configMessageFilter(uint8_t enable) {
+    getInstance()->enabled = enable != 0;
+    return 1;
+}
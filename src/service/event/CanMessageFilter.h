@@ -0,0 +1,63 @@
+﻿#ifndef DLLTEST_CANMESSAGEFILTER_H
+#define DLLTEST_CANMESSAGEFILTER_H
+
+#include <set>
+
+typedef void (*CanMessageHandler)(cclCanMessage *message);
+
+/*
+ * CanMessageFilter  CANoe 报文回调注册
+ * 测量开始前按各节点的 PhyAddr/FuncAddr/RespAddr 逐个注册 kVIA_OneId 回调，同时注册一个 CCL_CAN_ALLMESSAGES 回调
+ * 全部报文回调默认丢弃所有报文；没有已配置的节点、关闭了按 ID 注册、任一 ID 注册失败，
+ * 或测量开始后节点新增了未注册的 ID 时，全部报文回调转发未按 ID 注册的报文，已注册的 ID 仍只由按 ID 回调转发一次
+ * cclCanSetMessageHandler 只能在 PreStart 中调用，CCL 也没有注销回调的接口，注册结果在一次测量内保持不变
+ * */
+class CanMessageFilter {
+private:
+    bool enabled = true;        // 是否按 ID 注册
+    bool installed = false;     // 本次测量是否已注册
+    bool allInstalled = false;  // 本次测量全部报文回调是否注册成功
+    bool allMessages = false;   // 全部报文回调是否转发未注册 ID 的报文
+    int32_t channel = 0;
+    CanMessageHandler handler = nullptr;
+    std::set<uint32_t> registered;  // 本次测量已注册的 ID
+
+    static CanMessageFilter *instance;
+
+    static void onIdMessage(cclCanMessage *message);
+
+//    已按 ID 注册的报文由 onIdMessage 转发，这里跳过，避免同一帧收到两次
+    static void onAllMessage(cclCanMessage *message);
+
+    bool registerId(uint32_t id);
+
+//    全部报文回调开始转发未注册 ID 的报文
+    void passUnregistered(const char *reason);
+
+public:
+    static CanMessageFilter *getInstance() {
+        if (instance == nullptr) {
+            instance = new CanMessageFilter();
+        }
+        return instance;
+    }
+
+//    OnMeasurementPreStart 中调用，收集所有节点的诊断 ID 并注册回调
+    void install(int32_t channel, CanMessageHandler handler);
+
+//    节点地址变化时调用；新 ID 不再注册回调，由 PreStart 时注册的全部报文回调接收，下一次测量按 ID 注册
+    void addNode(Node *node);
+
+//    测量结束，CANoe 会释放全部回调
+    void reset();
+
+    [[nodiscard]] bool isAllMessages() const {
+        return allMessages;
+    }
+
+    static int8_t configMessageFilter(uint8_t enable);
+};
+
+CanMessageFilter *CanMessageFilter::instance = nullptr;
+
+#endif //DLLTEST_CANMESSAGEFILTER_H
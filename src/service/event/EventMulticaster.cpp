@@ -1,26 +1,90 @@
-//
+﻿//
 // Created by fanshuhua on 2024/6/17.
 //
 
+#include <algorithm>
 #include "EventMulticaster.h"
 
 void EventMulticaster::addListener(EventListener *listener) {
+    if (dispatchDepth > 0) {
+        pendingListeners.push_back(listener);
+        return;
+    }
     listeners.push_back(listener);
 }
 
+void EventMulticaster::addCanListener(EventListener *listener, int32_t channel, uint32_t id) {
+    CanRoute route = {routeKey(channel, id), listener};
+    if (dispatchDepth > 0) {
+        pendingRoutes.push_back(route);
+        return;
+    }
+    insertRoute(route);
+}
+
+void EventMulticaster::insertRoute(const CanRoute &route) {
+    auto it = std::upper_bound(canRoutes.begin(), canRoutes.end(), route.key,
+                               [](uint64_t key, const CanRoute &item) { return key < item.key; });
+    canRoutes.insert(it, route);
+}
+
 void EventMulticaster::removeListener(EventListener *listener) {
-    for (auto it = listeners.begin(); it != listeners.end(); it++) {
-        if (*it == listener) {
-            listeners.erase(it);
-            break;
+    for (auto &item: listeners) {
+        if (item == listener) {
+            item = nullptr;
+        }
+    }
+    for (auto &route: canRoutes) {
+        if (route.listener == listener) {
+            route.listener = nullptr;
         }
     }
+    std::erase(pendingListeners, listener);
+    std::erase_if(pendingRoutes, [listener](const CanRoute &route) { return route.listener == listener; });
+    removed = true;
+    if (dispatchDepth == 0) {
+        compact();
+    }
+}
+
+void EventMulticaster::compact() {
+    if (removed) {
+        std::erase(listeners, nullptr);
+        std::erase_if(canRoutes, [](const CanRoute &route) { return route.listener == nullptr; });
+        removed = false;
+    }
+    for (auto listener: pendingListeners) {
+        listeners.push_back(listener);
+    }
+    pendingListeners.clear();
+    for (auto &route: pendingRoutes) {
+        insertRoute(route);
+    }
+    pendingRoutes.clear();
 }
 
 void EventMulticaster::notify(EventType type, void *event) {
-    for (auto listener: listeners) {
-        if (listener->onEvent(type, event)) {
+    dispatchDepth++;
+    if (type == CanEvent) {
+        auto *message = static_cast<cclCanMessage *>(event);
+        uint64_t key = routeKey(message->channel, message->id);
+        auto it = std::lower_bound(canRoutes.begin(), canRoutes.end(), key,
+                                   [](const CanRoute &item, uint64_t key) { return item.key < key; });
+//        分发期间不会插入新路由，按下标遍历即可
+        for (size_t i = it - canRoutes.begin(); i < canRoutes.size() && canRoutes[i].key == key; ++i) {
+            EventListener *listener = canRoutes[i].listener;
+            if (listener != nullptr && listener->onEvent(type, event)) {
+                listener->run();
+            }
+        }
+    }
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        EventListener *listener = listeners[i];
+        if (listener != nullptr && listener->onEvent(type, event)) {
             listener->run();
         }
     }
+    if (--dispatchDepth == 0) {
+        compact();
+    }
 }
@@ -9,10 +9,34 @@
 
 /*
  * EventMulticaster  事件广播器
+ * CAN 报文按 (通道, CAN ID) 建有序索引，只分发给订阅了该 ID 的监听器；
+ * 通过 addListener 注册的监听器仍然接收所有事件
+ * 分发过程中增删监听器会延后到分发结束后再生效
  * */
 class EventMulticaster {
 private:
+    struct CanRoute {
+        uint64_t key;  // 通道 << 32 | CAN ID
+        EventListener *listener;
+    };
+
     std::vector<EventListener *> listeners;
+//    按 key 排序，相同 key 的监听器相邻
+    std::vector<CanRoute> canRoutes;
+    std::vector<CanRoute> pendingRoutes;
+    std::vector<EventListener *> pendingListeners;
+    int dispatchDepth = 0;
+    bool removed = false;
+
+    static uint64_t routeKey(int32_t channel, uint32_t id) {
+        return static_cast<uint64_t>(static_cast<uint32_t>(channel)) << 32 | id;
+    }
+
+    void insertRoute(const CanRoute &route);
+
+//    分发结束后清理已移除的监听器，并加入分发期间注册的监听器
+    void compact();
+
 public:
     static EventMulticaster *getInstance() {
         static EventMulticaster *instance = nullptr;
@@ -22,8 +46,12 @@ public:
         return instance;
     }
 
+//    接收所有事件
     void addListener(EventListener *listener);
 
+//    只接收指定通道、指定 CAN ID 的报文
+    void addCanListener(EventListener *listener, int32_t channel, uint32_t id);
+
     void removeListener(EventListener *listener);
 
     void notify(EventType type, void *event);
@@ -0,0 +1,46 @@
+﻿#ifndef DLLTEST_BLOCKHASH_H
+#define DLLTEST_BLOCKHASH_H
+
+#include <cstdint>
+#include <cstring>
+
+// 64 位内容哈希，每次处理 8 字节，用作缓存的键和增量刷写的块比较，不用于校验传输
+static uint64_t hashBytes(const uint8_t *data, uint64_t length) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ length;
+    uint64_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash ^= word * 0x87C37B91114253D5ULL;
+        hash = (hash << 29 | hash >> 35) * 0x4CF5AD432745937FULL;
+    }
+    for (; i < length; ++i) {
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// 数据是否全为 0xFF，即擦除后的状态
+static bool isBlank(const uint8_t *data, uint64_t length) {
+    uint64_t i = 0;
+    uint64_t all = ~0ULL;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        all &= word;
+        if (all != ~0ULL) {
+            return false;
+        }
+    }
+    for (; i < length; ++i) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif //DLLTEST_BLOCKHASH_H
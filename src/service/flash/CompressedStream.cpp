@@ -0,0 +1,118 @@
+﻿#include "CompressedStream.h"
+
+void CompressedStream::fill() {
+    while (pending.size() < COMPRESS_PIPELINE_DEPTH && submitted < length) {
+        const uint8_t *block = data + submitted;
+        uint32_t blockLength = length - submitted < LZ4_BLOCK_MAX_SIZE ? length - submitted : LZ4_BLOCK_MAX_SIZE;
+        bool first = submitted == 0;
+        bool last = submitted + blockLength == length;
+        pending.push_back({ThreadPool::getInstance()->submit([block, blockLength, first, last,
+                                                                     cancelled = cancelled, retained = owner] {
+            std::vector<uint8_t> output;
+//            流已关闭，结果不会再被取走
+            if (cancelled->load(std::memory_order_relaxed)) {
+                return output;
+            }
+            output.reserve(4 + lz4BlockBound(blockLength) + 11);
+            if (first) {
+                lz4FrameHeader(&output);
+            }
+            lz4AppendBlock(block, blockLength, &output);
+            if (last) {
+                lz4FrameEnd(&output);
+            }
+            return output;
+        }), blockLength});
+        submitted += blockLength;
+        if (checksum != nullptr) {
+            checksum->update(block, blockLength);
+        }
+    }
+}
+
+bool CompressedStream::collect() {
+    if (pending.empty() || pending.front().output.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+    std::vector<uint8_t> output = pending.front().output.get();
+    uint64_t sourceEnd = (chunks.empty() ? chunkSourceStart : chunks.back().sourceEnd) + pending.front().sourceLength;
+    pending.pop_front();
+    streamLength += output.size();
+    chunks.push_back({streamLength, sourceEnd});
+//    已确认的部分超过一半时整体前移，buffer 不随下载长度增长
+    if (consumed > buffer.size() / 2) {
+        buffer.erase(buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(consumed));
+        consumed = 0;
+    }
+    buffer.insert(buffer.end(), output.begin(), output.end());
+    ended = pending.empty() && submitted == length;
+    fill();
+    return true;
+}
+
+void CompressedStream::open(const uint8_t *source, uint32_t sourceLength, IncrementalCrc *sourceChecksum,
+                            std::shared_ptr<const void> sourceOwner) {
+    close();
+    data = source;
+    length = sourceLength;
+    checksum = sourceChecksum;
+    owner = std::move(sourceOwner);
+    cancelled = std::make_shared<std::atomic<bool>>(false);
+    fill();
+}
+
+uint32_t CompressedStream::peek(uint32_t maxLength, const uint8_t **block) {
+//    不够一整块时才取下一个压缩结果，后面始终保持 COMPRESS_PIPELINE_DEPTH 个任务在压缩
+    while (buffer.size() - consumed < maxLength && collect()) {}
+    size_t available = buffer.size() - consumed;
+    *block = buffer.data() + consumed;
+//    流末尾可以发不满一块，中间凑不够一块时等压缩完成，不发短块
+    if (available < maxLength && !ended) {
+        stalls++;
+        return 0;
+    }
+    return available < maxLength ? static_cast<uint32_t>(available) : maxLength;
+}
+
+void CompressedStream::consume(uint32_t blockLength) {
+    consumed += blockLength;
+    acknowledged += blockLength;
+    while (!chunks.empty() && chunks.front().streamEnd <= acknowledged) {
+        chunkStreamStart = chunks.front().streamEnd;
+        chunkSourceStart = chunks.front().sourceEnd;
+        chunks.pop_front();
+    }
+}
+
+uint64_t CompressedStream::sourceAcknowledged() const {
+    if (chunks.empty()) {
+        return chunkSourceStart;
+    }
+    const CompressedChunk &chunk = chunks.front();
+    return chunkSourceStart + (acknowledged - chunkStreamStart) * (chunk.sourceEnd - chunkSourceStart)
+                              / (chunk.streamEnd - chunkStreamStart);
+}
+
+void CompressedStream::close() {
+//    任务持有自己的数据引用和输出缓冲区，这里只通知它们不必再压缩，丢弃 future 不会等待
+    if (cancelled != nullptr) {
+        cancelled->store(true, std::memory_order_relaxed);
+        cancelled = nullptr;
+    }
+    owner = nullptr;
+    pending.clear();
+    buffer.clear();
+    buffer.shrink_to_fit();
+    consumed = 0;
+    chunks.clear();
+    streamLength = 0;
+    acknowledged = 0;
+    chunkStreamStart = 0;
+    chunkSourceStart = 0;
+    submitted = 0;
+    data = nullptr;
+    length = 0;
+    checksum = nullptr;
+    ended = false;
+    stalls = 0;
+}
@@ -0,0 +1,102 @@
+﻿#ifndef DLLTEST_COMPRESSEDSTREAM_H
+#define DLLTEST_COMPRESSEDSTREAM_H
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+#include "Lz4Frame.h"
+#include "IncrementalCrc.h"
+
+// 提前压缩的块数，总线上每发一块之前后面已有这么多块在工作线程上压缩
+#define COMPRESS_PIPELINE_DEPTH 4
+
+/*
+ * CompressedStream  下载数据的压缩流
+ * 一次下载的原始数据按 64KB 切块，提交到 ThreadPool 压缩，输出为标准 LZ4 帧(独立块)
+ * TransferData 每次从流的前端取一块发送，取走的同时补充新的压缩任务；只取已经压缩完的结果，从不等待工作线程，
+ * 凑不够一块时 peek 返回0，由调用方稍后重试
+ * 记录每个压缩结果对应的原始数据范围，ECU 确认的压缩字节可以折算回原始字节，进度与不压缩时含义相同
+ * 压缩任务持有原始数据所有者(FlashImage::retain)的引用，压缩结果写在任务自己的缓冲区里；
+ * close 不等待未完成的任务：置位取消标记，还没开始的任务直接返回，正在压缩的任务结果被丢弃
+ * */
+class CompressedStream {
+private:
+    typedef struct PendingBlock {
+        std::future<std::vector<uint8_t>> output;
+        uint32_t sourceLength;
+    } PendingBlock;
+
+//    已追加到 buffer 的一个压缩结果，两个位置都是从流开始算起的累计字节数
+    typedef struct CompressedChunk {
+        uint64_t streamEnd;
+        uint64_t sourceEnd;
+    } CompressedChunk;
+
+    const uint8_t *data = nullptr;
+    uint32_t length = 0;
+    IncrementalCrc *checksum = nullptr;
+    std::shared_ptr<const void> owner;                 // 原始数据的所有者，压缩任务各持有一份
+    std::shared_ptr<std::atomic<bool>> cancelled;      // 本次打开的流的取消标记，压缩任务各持有一份
+    uint32_t submitted = 0;  // 已提交压缩的原始字节数
+    std::deque<PendingBlock> pending;
+//    已压缩、尚未被 ECU 确认的数据，consumed 之前的部分已确认
+    std::vector<uint8_t> buffer;
+    size_t consumed = 0;
+//    尚未全部确认的压缩结果，以及已全部确认部分的累计位置
+    std::deque<CompressedChunk> chunks;
+    uint64_t streamLength = 0;
+    uint64_t acknowledged = 0;
+    uint64_t chunkStreamStart = 0;
+    uint64_t chunkSourceStart = 0;
+    bool ended = false;      // 已追加帧结束标记
+    uint64_t stalls = 0;     // 需要数据时压缩尚未完成的次数
+
+//    补充压缩任务到 COMPRESS_PIPELINE_DEPTH 个
+    void fill();
+
+//    最前面的压缩结果已完成时追加到 buffer，尚未完成或没有进行中的任务时返回 false，不等待
+    bool collect();
+
+public:
+    CompressedStream() = default;
+
+    CompressedStream(const CompressedStream &compressedStream) = delete;
+
+    CompressedStream &operator=(const CompressedStream &compressedStream) = delete;
+
+//    开始压缩 [data, data + length)，立即提交第一批压缩任务；checksum 不为空时每提交一块原始数据同时交给它计算 CRC
+//    sourceOwner 为原始数据的所有者，压缩任务持有它，流关闭后任务读取的数据仍然有效
+    void open(const uint8_t *source, uint32_t sourceLength, IncrementalCrc *sourceChecksum,
+              std::shared_ptr<const void> sourceOwner);
+
+//    取下一块待发送数据，最多 maxLength 字节，数据在 consume 之前有效
+//    已压缩的数据不足一块且流未结束时返回0，不等待压缩，稍后再取
+    uint32_t peek(uint32_t maxLength, const uint8_t **block);
+
+//    ECU 已确认前 blockLength 字节
+    void consume(uint32_t blockLength);
+
+//    已确认的压缩数据折算成的原始字节数，压缩结果内部按比例折算
+    [[nodiscard]] uint64_t sourceAcknowledged() const;
+
+//    所有数据都已被确认
+    [[nodiscard]] bool finished() const {
+        return ended && consumed == buffer.size() && pending.empty();
+    }
+
+//    放弃未完成的压缩任务并释放缓冲区，不等待
+    void close();
+
+    [[nodiscard]] uint64_t getStalls() const {
+        return stalls;
+    }
+
+    ~CompressedStream() {
+        close();
+    }
+};
+
+
+#endif //DLLTEST_COMPRESSEDSTREAM_H
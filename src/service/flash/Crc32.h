@@ -0,0 +1,106 @@
+﻿#ifndef DLLTEST_CRC32_H
+#define DLLTEST_CRC32_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+// CRC-32(IEEE 802.3)，反射多项式 0xEDB88320，初值和结果异或 0xFFFFFFFF
+constexpr std::array<uint32_t, 256> CRC32_TABLE = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 1 ? crc >> 1 ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+// slicing-by-8 表：SLICE[k][b] 为字节 b 后面再跟 k 个 0 字节的 CRC，每次查 8 张表处理 8 字节
+constexpr std::array<std::array<uint32_t, 256>, 8> CRC32_SLICE_TABLE = [] {
+    std::array<std::array<uint32_t, 256>, 8> table{};
+    table[0] = CRC32_TABLE;
+    for (size_t k = 1; k < 8; ++k) {
+        for (size_t i = 0; i < 256; ++i) {
+            table[k][i] = table[k - 1][i] >> 8 ^ CRC32_TABLE[table[k - 1][i] & 0xFF];
+        }
+    }
+    return table;
+}();
+
+// 在已有 CRC 之后继续计算，crc 为上一段的最终结果，第一段传0；按小端读取 8 字节
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, uint64_t length) {
+    const auto &table = CRC32_SLICE_TABLE;
+    crc = ~crc;
+    uint64_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint32_t low = crc ^ (data[i] | data[i + 1] << 8 | data[i + 2] << 16 | static_cast<uint32_t>(data[i + 3]) << 24);
+        uint32_t high = data[i + 4] | data[i + 5] << 8 | data[i + 6] << 16 | static_cast<uint32_t>(data[i + 7]) << 24;
+        crc = table[7][low & 0xFF] ^ table[6][low >> 8 & 0xFF] ^ table[5][low >> 16 & 0xFF] ^ table[4][low >> 24]
+              ^ table[3][high & 0xFF] ^ table[2][high >> 8 & 0xFF] ^ table[1][high >> 16 & 0xFF] ^ table[0][high >> 24];
+    }
+    for (; i < length; ++i) {
+        crc = CRC32_TABLE[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+    }
+    return ~crc;
+}
+
+static uint32_t crc32(const uint8_t *data, uint64_t length) {
+    return crc32Update(0, data, length);
+}
+
+// GF(2) 上 32x32 矩阵乘向量，matrix[i] 为第 i 位对应的列
+static uint32_t crc32MatrixTimes(const uint32_t *matrix, uint32_t vector) {
+    uint32_t sum = 0;
+    for (int i = 0; vector != 0; ++i, vector >>= 1) {
+        if (vector & 1) {
+            sum ^= matrix[i];
+        }
+    }
+    return sum;
+}
+
+// 在 CRC 寄存器后面补 length 个 0 字节的算子(对长度做平方幂)，与 zlib 的 crc32_combine 相同
+static void crc32ZerosOperator(uint64_t length, uint32_t *result) {
+    uint32_t power[32];
+    uint32_t square[32];
+    auto multiply = [](uint32_t *target, const uint32_t *left, const uint32_t *right) {
+        for (int i = 0; i < 32; ++i) {
+            target[i] = crc32MatrixTimes(left, right[i]);
+        }
+    };
+//    补 1 个 0 位的算子，再平方三次得到补 1 个 0 字节的算子
+    power[0] = 0xEDB88320u;
+    for (int i = 1; i < 32; ++i) {
+        power[i] = 1u << (i - 1);
+    }
+    for (int i = 0; i < 3; ++i) {
+        multiply(square, power, power);
+        memcpy(power, square, sizeof(power));
+    }
+//    result 从单位矩阵开始，按 length 的二进制位累乘 power
+    for (int i = 0; i < 32; ++i) {
+        result[i] = 1u << i;
+    }
+    for (; length != 0; length >>= 1) {
+        if (length & 1) {
+            multiply(square, power, result);
+            memcpy(result, square, sizeof(square));
+        }
+        if (length > 1) {
+            multiply(square, power, power);
+            memcpy(power, square, sizeof(power));
+        }
+    }
+}
+
+// 合并两段的 CRC：crc1 为前一段，crc2 为后一段(长度 length2)，结果等于两段拼接后的 CRC
+static uint32_t crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t length2) {
+    uint32_t zeros[32];
+    crc32ZerosOperator(length2, zeros);
+    return crc32MatrixTimes(zeros, crc1) ^ crc2;
+}
+
+#endif //DLLTEST_CRC32_H
@@ -0,0 +1,199 @@
+﻿#include <fstream>
+#include "DeltaPlan.h"
+#include "BlockHash.h"
+
+// 清单文件 "FHSH"，格式变化时递增版本号
+#define FLASH_MANIFEST_MAGIC 0x48534846u
+#define FLASH_MANIFEST_VERSION 1u
+
+typedef struct FlashManifestHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t regionSize;
+    uint32_t regionCount;
+} FlashManifestHeader;
+
+void DeltaPlan::hashRegions(const FlashImage &image, uint32_t regionSize, std::vector<RegionHash> *regionHashes) {
+    regionHashes->clear();
+    for (uint32_t i = 0; i < image.segmentCount(); ++i) {
+        const FlashSegment &segment = image.segment(i);
+        const uint8_t *data = image.segmentData(i);
+        uint64_t end = static_cast<uint64_t>(segment.address) + segment.length;
+        for (uint64_t address = segment.address; address < end;) {
+//            区域按 regionSize 对齐，段首尾不对齐时首尾区域较短
+            uint64_t regionEnd = address - address % regionSize + regionSize;
+            regionEnd = regionEnd < end ? regionEnd : end;
+            auto length = static_cast<uint32_t>(regionEnd - address);
+            regionHashes->push_back({static_cast<uint32_t>(address), length,
+                                     hashBytes(data + (address - segment.address), length)});
+            address = regionEnd;
+        }
+    }
+}
+
+bool DeltaPlan::readManifest(const std::string &path, uint32_t regionSize, std::vector<RegionHash> *regionHashes) {
+    std::ifstream file(path, std::ios::binary);
+    FlashManifestHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != FLASH_MANIFEST_MAGIC
+        || header.version != FLASH_MANIFEST_VERSION || header.regionSize != regionSize) {
+        return false;
+    }
+//    区域数来自文件内容，先和剩余长度比较，损坏的清单不能触发超大的分配
+    std::streamoff dataStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff remaining = file.tellg() - dataStart;
+    file.seekg(dataStart);
+    if (remaining < 0 || header.regionCount > static_cast<uint64_t>(remaining) / sizeof(RegionHash)) {
+        return false;
+    }
+    regionHashes->resize(header.regionCount);
+    if (!file.read(reinterpret_cast<char *>(regionHashes->data()),
+                   static_cast<std::streamsize>(header.regionCount * sizeof(RegionHash)))) {
+        regionHashes->clear();
+        return false;
+    }
+    return true;
+}
+
+bool DeltaPlan::writeManifest(const std::string &path, uint32_t regionSize,
+                              const std::vector<RegionHash> &regionHashes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    FlashManifestHeader header = {FLASH_MANIFEST_MAGIC, FLASH_MANIFEST_VERSION, regionSize,
+                                  static_cast<uint32_t>(regionHashes.size())};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(regionHashes.data()),
+               static_cast<std::streamsize>(regionHashes.size() * sizeof(RegionHash)));
+    return file.good();
+}
+
+void DeltaPlan::full(const FlashImage &image, bool erase, bool check, std::vector<FlashOperation> *operations) {
+    operations->clear();
+    for (uint32_t i = 0; i < image.segmentCount(); ++i) {
+        const FlashSegment &segment = image.segment(i);
+        FlashOperation operation;
+        operation.address = segment.address;
+        operation.length = segment.length;
+        operation.data = image.segmentData(i);
+        operation.segment = static_cast<int32_t>(i);
+        if (erase) {
+            operation.type = FlashEraseOperation;
+            operations->push_back(operation);
+            operation.type = FlashDownloadOperation;
+        }
+        operations->push_back(operation);
+        if (check) {
+            operation.type = FlashCheckOperation;
+            operations->push_back(operation);
+        }
+    }
+}
+
+// 以 [begin, end) 为范围追加一步，data 为 begin 处的数据
+static void addOperation(std::vector<FlashOperation> *operations, FlashOperationType type, uint32_t begin,
+                         uint32_t end, const uint8_t *data) {
+    FlashOperation operation;
+    operation.type = type;
+    operation.address = begin;
+    operation.length = end - begin;
+    operation.data = data;
+    operations->push_back(operation);
+}
+
+void DeltaPlan::delta(const FlashImage &image, uint32_t regionSize, const std::vector<RegionHash> &regionHashes,
+                      const std::vector<RegionHash> *reference, bool erase, bool check,
+                      std::vector<FlashOperation> *operations, DeltaStatistics *statistics) {
+    operations->clear();
+    *statistics = {};
+    std::unordered_map<uint32_t, const RegionHash *> referenceMap;
+    if (reference != nullptr) {
+        referenceMap.reserve(reference->size());
+        for (const RegionHash &regionHash: *reference) {
+            referenceMap[regionHash.address] = &regionHash;
+        }
+    }
+    auto changed = [&](const RegionHash &regionHash) {
+        auto found = referenceMap.find(regionHash.address);
+        return found == referenceMap.end() || found->second->length != regionHash.length
+               || found->second->hash != regionHash.hash;
+    };
+//    区域和段都按地址排序，顺序推进找到区域所在的段
+    uint32_t segmentIndex = 0;
+    auto dataAt = [&](uint32_t address) {
+        while (static_cast<uint64_t>(image.segment(segmentIndex).address) + image.segment(segmentIndex).length
+               <= address) {
+            segmentIndex++;
+        }
+        return image.segmentData(segmentIndex) + (address - image.segment(segmentIndex).address);
+    };
+//    正在合并的擦除范围和下载范围，0 长度表示没有；相邻地址一定在同一段内，下载范围不会跨段
+    uint64_t eraseBegin = 0, eraseEnd = 0;
+    uint32_t downloadBegin = 0, downloadEnd = 0;
+    const uint8_t *downloadData = nullptr;
+//    擦除必须在它范围内的下载之前，记录擦除范围开始时的位置，结束时插入到这里
+    size_t eraseIndex = 0;
+    auto flushDownload = [&]() {
+        if (downloadEnd > downloadBegin) {
+            addOperation(operations, FlashDownloadOperation, downloadBegin, downloadEnd, downloadData);
+            if (check) {
+                addOperation(operations, FlashCheckOperation, downloadBegin, downloadEnd, downloadData);
+            }
+            statistics->transferred += downloadEnd - downloadBegin;
+        }
+        downloadBegin = downloadEnd = 0;
+    };
+    auto flushErase = [&]() {
+        flushDownload();
+        if (eraseEnd > eraseBegin) {
+            FlashOperation operation;
+            operation.type = FlashEraseOperation;
+            operation.address = static_cast<uint32_t>(eraseBegin);
+            operation.length = static_cast<uint32_t>(eraseEnd - eraseBegin);
+            operations->insert(operations->begin() + static_cast<ptrdiff_t>(eraseIndex), operation);
+            statistics->erased += eraseEnd - eraseBegin;
+        }
+        eraseBegin = eraseEnd = 0;
+    };
+//    区域按 regionSize 对齐的块分组，段的首尾区域可能只占块的一部分，一个块里也可能有多段的区域；
+//    ECU 按扇区擦除，块内任一区域有变化时擦除整块，块内镜像的每个字节都要重新下载，不能只下载有变化的区域
+    for (size_t region = 0; region < regionHashes.size();) {
+        uint64_t blockBegin = regionHashes[region].address - regionHashes[region].address % regionSize;
+        uint64_t blockEnd = blockBegin + regionSize;
+        size_t blockFirst = region;
+        bool blockChanged = false;
+        for (; region < regionHashes.size() && regionHashes[region].address < blockEnd; ++region) {
+            blockChanged = blockChanged || changed(regionHashes[region]);
+        }
+        if (!blockChanged) {
+            for (size_t i = blockFirst; i < region; ++i) {
+                statistics->unchanged += regionHashes[i].length;
+            }
+            flushErase();
+            continue;
+        }
+        if (erase && eraseEnd != blockBegin) {
+            flushErase();
+            eraseBegin = blockBegin;
+            eraseIndex = operations->size();
+        }
+        if (erase) {
+            eraseEnd = blockEnd;
+        }
+        for (size_t i = blockFirst; i < region; ++i) {
+            const RegionHash &regionHash = regionHashes[i];
+            const uint8_t *data = dataAt(regionHash.address);
+//            擦除后已是 0xFF 的区域不需要传输；没有擦除例程时 RequestDownload 才擦除，空白区域也要下载
+            if (erase && isBlank(data, regionHash.length)) {
+                statistics->blank += regionHash.length;
+                flushDownload();
+                continue;
+            }
+            if (downloadEnd == downloadBegin || downloadEnd != regionHash.address) {
+                flushDownload();
+                downloadBegin = regionHash.address;
+                downloadData = data;
+            }
+            downloadEnd = regionHash.address + regionHash.length;
+        }
+    }
+    flushErase();
+}
@@ -0,0 +1,68 @@
+﻿#ifndef DLLTEST_DELTAPLAN_H
+#define DLLTEST_DELTAPLAN_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FlashImage.h"
+
+enum FlashOperationType {
+    FlashEraseOperation,     // 31 01 擦除例程
+    FlashDownloadOperation,  // 34 / 36... / 37
+    FlashCheckOperation,     // 31 01 校验例程
+};
+
+// 下载流程中的一步，data 指向 FlashImage 的段数据
+typedef struct FlashOperation {
+    FlashOperationType type = FlashDownloadOperation;
+    uint32_t address = 0;
+    uint32_t length = 0;
+    const uint8_t *data = nullptr;
+    int32_t segment = -1;  // 整段校验时使用镜像后台算好的段 CRC，-1 表示按范围计算
+} FlashOperation;
+
+// 一个区域的内容哈希，区域按 regionSize 对齐地址划分，不跨段，段首尾的区域可能较短
+typedef struct RegionHash {
+    uint32_t address = 0;
+    uint32_t length = 0;
+    uint64_t hash = 0;
+} RegionHash;
+
+// 增量刷写统计，单位字节
+typedef struct DeltaStatistics {
+    uint64_t unchanged = 0;  // 与参考一致，不擦除也不传输
+    uint64_t blank = 0;      // 有变化但全为 0xFF，擦除后不需要传输
+    uint64_t erased = 0;
+    uint64_t transferred = 0;
+} DeltaStatistics;
+
+/*
+ * DeltaPlan  增量刷写计划
+ * 新镜像按 regionSize 对齐划分区域并计算哈希，与参考(上次成功刷写时保存的 .fhash 清单，或参考镜像)逐区域比较
+ * 比较以 regionSize 对齐的块为单位，一个块可能包含多段的首尾区域：块内区域都一致时跳过；任一区域有变化时擦除整块，
+ * 块内全部镜像数据重新下载，擦除范围因此总是按块对齐，不会切开扇区而丢掉同一扇区内未变化的数据
+ * 连续的有变化块合并为一次擦除，其中非空白的连续数据合并为一次下载，每次下载后可选校验
+ * ECU 不支持擦除例程时认为 RequestDownload 会擦除下载范围，有变化的空白区域也要传输
+ * 整段下载和增量下载一样，配置了擦除例程时每段下载前先擦除该段
+ * */
+class DeltaPlan {
+public:
+//    按 regionSize 划分镜像并计算每个区域的哈希
+    static void hashRegions(const FlashImage &image, uint32_t regionSize, std::vector<RegionHash> *regionHashes);
+
+//    读取 .fhash 清单，regionSize 与当前配置不一致、区域数与文件长度不符或文件无效时返回 false
+    static bool readManifest(const std::string &path, uint32_t regionSize, std::vector<RegionHash> *regionHashes);
+
+    static bool writeManifest(const std::string &path, uint32_t regionSize, const std::vector<RegionHash> &regionHashes);
+
+//    整段下载：每段一次下载，配置了擦除例程时下载前擦除该段，配置了校验例程时每段校验一次，校验使用镜像的段 CRC
+    static void full(const FlashImage &image, bool erase, bool check, std::vector<FlashOperation> *operations);
+
+//    增量下载：regionHashes 由 hashRegions 按 regionSize 生成，reference 为空时所有区域都视为有变化
+    static void delta(const FlashImage &image, uint32_t regionSize, const std::vector<RegionHash> &regionHashes,
+                      const std::vector<RegionHash> *reference, bool erase, bool check,
+                      std::vector<FlashOperation> *operations, DeltaStatistics *statistics);
+};
+
+
+#endif //DLLTEST_DELTAPLAN_H
@@ -0,0 +1,481 @@
+﻿#include "FlashDownload.h"
+
+#define UDS_REQUEST_DOWNLOAD 0x34
+#define UDS_TRANSFER_DATA 0x36
+#define UDS_REQUEST_TRANSFER_EXIT 0x37
+#define UDS_ROUTINE_CONTROL 0x31
+#define UDS_START_ROUTINE 0x01
+// dataFormatIdentifier：高4位压缩方式、低4位加密方式，不加密
+#define FLASH_COMPRESSION_SHIFT 4
+// addressAndLengthFormatIdentifier：地址4字节、长度4字节
+#define FLASH_ADDRESS_AND_LENGTH_FORMAT 0x44
+
+// 增量清单的扩展名，参考路径使用其他扩展名时按镜像文件加载
+#define FLASH_MANIFEST_EXTENSION ".fhash"
+
+void FlashDownload::nextOperation() {
+    if (operationIndex >= operations.size()) {
+        finish();
+        return;
+    }
+    const FlashOperation &operation = operations[operationIndex];
+    if (operation.type == FlashDownloadOperation) {
+        requestDownload();
+    } else {
+        routineControl(operation);
+    }
+}
+
+void FlashDownload::requestDownload() {
+    const FlashOperation &operation = operations[operationIndex];
+    uint32_t memoryAddress = operation.address;
+    uint32_t size = operation.length;
+    uint8_t dataFormat = static_cast<uint8_t>(config().compressionMethod << FLASH_COMPRESSION_SHIFT);
+    uint8_t request[] = {UDS_REQUEST_DOWNLOAD, dataFormat, FLASH_ADDRESS_AND_LENGTH_FORMAT,
+                         static_cast<uint8_t>(memoryAddress >> 24), static_cast<uint8_t>(memoryAddress >> 16),
+                         static_cast<uint8_t>(memoryAddress >> 8), static_cast<uint8_t>(memoryAddress),
+                         static_cast<uint8_t>(size >> 24), static_cast<uint8_t>(size >> 16),
+                         static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size)};
+    state = FlashRequestDownload;
+    offset = 0;
+//    每次 RequestDownload 之后块序号重新从 1 开始
+    blockSequenceCounter = 0;
+//    memorySize 为原始长度；等待 0x74 的同时开始压缩前几块
+//    整段下载的校验使用镜像的段 CRC，不随发送计算
+    transferCrc.reset(image.retain());
+    transferCrcLength = 0;
+    if (config().compressionMethod != 0) {
+        compressedStream.open(operation.data, operation.length, operation.segment < 0 ? &transferCrc : nullptr,
+                              image.retain());
+    }
+    sessionId = DiagServer::sendByPhysical(node->NodeHandle, request, sizeof(request));
+    if (sessionId == 0) {
+        fail("RequestDownload 提交失败");
+    }
+}
+
+void FlashDownload::transferData() {
+    const FlashOperation &operation = operations[operationIndex];
+    const uint8_t *block;
+    if (config().compressionMethod != 0) {
+        pendingLength = compressedStream.peek(blockLength, &block);
+        if (pendingLength == 0) {
+            state = FlashTransferData;
+            retryLater();
+            return;
+        }
+    } else {
+        uint64_t remaining = operation.length - offset;
+        pendingLength = remaining > blockLength ? blockLength : static_cast<uint32_t>(remaining);
+        block = operation.data + offset;
+        if (operation.segment < 0) {
+            transferCrc.update(block, pendingLength);
+        }
+    }
+//    块序号 0xFF 之后回到 0x00
+    blockSequenceCounter++;
+    uint8_t header[] = {UDS_TRANSFER_DATA, blockSequenceCounter};
+    state = FlashTransferData;
+    sessionId = DiagServer::sendReference(node->NodeHandle, header, sizeof(header),
+                                          block, pendingLength);
+    if (sessionId == 0) {
+        fail("TransferData 提交失败");
+    }
+}
+
+void FlashDownload::transferExit() {
+    uint8_t request[] = {UDS_REQUEST_TRANSFER_EXIT};
+    state = FlashTransferExit;
+    sessionId = DiagServer::sendByPhysical(node->NodeHandle, request, sizeof(request));
+    if (sessionId == 0) {
+        fail("RequestTransferExit 提交失败");
+    }
+}
+
+bool FlashDownload::checkCrc(const FlashOperation &operation, uint32_t *crc) {
+    if (operation.segment >= 0) {
+        return image.tryCrc(static_cast<uint32_t>(operation.segment), crc);
+    }
+//    范围正是刚下载完的数据时 CRC 已随发送计算；否则把这个范围交给 IncrementalCrc 在工作线程上重新计算
+    if (transferCrcLength == 0 || operation.address != transferCrcAddress || operation.length != transferCrcLength) {
+        transferCrc.reset(image.retain());
+        transferCrc.update(operation.data, operation.length);
+        transferCrcAddress = operation.address;
+        transferCrcLength = operation.length;
+    }
+    return transferCrc.tryDigest(crc);
+}
+
+void FlashDownload::retryLater() {
+    TimerScheduler::getInstance()->schedule(&retryTask, TimerScheduler::now() + cclTimeMilliseconds(
+            FLASH_RETRY_INTERVAL));
+}
+
+void FlashDownload::routineControl(const FlashOperation &operation) {
+    uint16_t routine = operation.type == FlashEraseOperation ? config().eraseRoutine : config().checkRoutine;
+//    31 01 RID 44 地址 长度，校验例程再附加 CRC32
+    uint32_t crc = 0;
+    if (operation.type == FlashCheckOperation && !checkCrc(operation, &crc)) {
+        state = FlashCheckMemory;
+        retryLater();
+        return;
+    }
+    uint8_t request[] = {UDS_ROUTINE_CONTROL, UDS_START_ROUTINE, static_cast<uint8_t>(routine >> 8),
+                         static_cast<uint8_t>(routine), FLASH_ADDRESS_AND_LENGTH_FORMAT,
+                         static_cast<uint8_t>(operation.address >> 24), static_cast<uint8_t>(operation.address >> 16),
+                         static_cast<uint8_t>(operation.address >> 8), static_cast<uint8_t>(operation.address),
+                         static_cast<uint8_t>(operation.length >> 24), static_cast<uint8_t>(operation.length >> 16),
+                         static_cast<uint8_t>(operation.length >> 8), static_cast<uint8_t>(operation.length),
+                         static_cast<uint8_t>(crc >> 24), static_cast<uint8_t>(crc >> 16),
+                         static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc)};
+    uint32_t length = operation.type == FlashEraseOperation ? sizeof(request) - 4 : sizeof(request);
+    state = operation.type == FlashEraseOperation ? FlashEraseMemory : FlashCheckMemory;
+    sessionId = DiagServer::sendByPhysical(node->NodeHandle, request, length);
+    if (sessionId == 0) {
+        fail("RoutineControl 提交失败");
+    }
+}
+
+void FlashDownload::finish() {
+    state = FlashFinished;
+    endTime = TimerScheduler::now();
+    long long elapsed = (endTime - startTime) / 1000000;
+    cclPrintf("FlashDownload 0x%X 完成 %u 段 %llu 字节，%u 块，块长度 %u，耗时 %lld ms",
+              node->diagConfig->PhyAddr, image.segmentCount(), confirmed, blockCount, blockLength, elapsed);
+    if (config().compressionMethod != 0 && uncompressedLength > 0) {
+        cclPrintf("FlashDownload 0x%X 压缩 %llu -> %llu 字节，压缩率 %.1f%%，等待压缩 %llu 次",
+                  node->diagConfig->PhyAddr, uncompressedLength, compressedLength,
+                  100.0 * static_cast<double>(compressedLength) / static_cast<double>(uncompressedLength),
+                  compressionStalls);
+    }
+    if (regionHashes.empty()) {
+        return;
+    }
+    cclPrintf("FlashDownload 0x%X 增量刷写：未变化 %llu 字节，空白 %llu 字节，擦除 %llu 字节，传输 %llu 字节",
+              node->diagConfig->PhyAddr, deltaStatistics.unchanged, deltaStatistics.blank, deltaStatistics.erased,
+              deltaStatistics.transferred);
+//    只有成功刷写后才保存清单，下一次增量下载以它为参考
+    if (!manifestPath.empty() && !DeltaPlan::writeManifest(manifestPath, config().regionSize, regionHashes)) {
+        cclPrintf("FlashDownload 0x%X 清单 %s 写入失败", node->diagConfig->PhyAddr, manifestPath.c_str());
+    }
+}
+
+uint32_t FlashDownload::maxNumberOfBlockLength(const std::vector<uint8_t> &response) {
+//    74 LFID maxNumberOfBlockLength，LFID 高4位为长度字节数
+    if (response.size() < 2) {
+        return 0;
+    }
+    uint8_t length = response[1] >> 4;
+    if (length == 0 || response.size() < 2u + length) {
+        return 0;
+    }
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < length; ++i) {
+        value = value << 8 | response[2 + i];
+    }
+    return value;
+}
+
+void FlashDownload::onResponse(DiagSession *session) {
+    sessionId = 0;
+    if (session->diagSessionState == failed || session->getErrorStatus(NegativeResponse)) {
+        cclPrintf("FlashDownload 0x%X 诊断 %u 失败，errorStatus=0x%X", node->diagConfig->PhyAddr, session->id,
+                  session->errorStatus);
+        fail("请求未得到正响应");
+        return;
+    }
+    const std::vector<uint8_t> &response = session->responseData;
+    switch (state) {
+        case FlashRequestDownload: {
+            uint32_t maxBlockLength = maxNumberOfBlockLength(response);
+//            maxNumberOfBlockLength 包含 SID 和块序号
+            if (maxBlockLength <= 2) {
+                fail("0x74 响应中的 maxNumberOfBlockLength 无效");
+                return;
+            }
+            blockLength = maxBlockLength - 2;
+            transferData();
+            return;
+        }
+        case FlashTransferData:
+            if (response.size() < 2 || response[1] != blockSequenceCounter) {
+                fail("0x76 响应的块序号与请求不一致");
+                return;
+            }
+            offset += pendingLength;
+            blockCount++;
+            if (config().compressionMethod != 0) {
+                uint64_t acknowledged = compressedStream.sourceAcknowledged();
+                compressedStream.consume(pendingLength);
+                confirmed += compressedStream.sourceAcknowledged() - acknowledged;
+                if (!compressedStream.finished()) {
+                    transferData();
+                    return;
+                }
+                compressionStalls += compressedStream.getStalls();
+                compressedStream.close();
+            } else {
+                confirmed += pendingLength;
+                if (offset < operations[operationIndex].length) {
+                    transferData();
+                    return;
+                }
+            }
+            uncompressedLength += operations[operationIndex].length;
+            compressedLength += offset;
+            if (operations[operationIndex].segment < 0) {
+                transferCrcAddress = operations[operationIndex].address;
+                transferCrcLength = operations[operationIndex].length;
+            }
+            transferExit();
+            return;
+        case FlashEraseMemory:
+        case FlashCheckMemory:
+//            71 01 RID routineStatus，状态字节存在且不为0时视为例程失败
+            if (response.size() > 4 && response[4] != 0) {
+                fail(state == FlashEraseMemory ? "擦除例程返回失败" : "校验例程返回失败");
+                return;
+            }
+            operationIndex++;
+            nextOperation();
+            return;
+        case FlashTransferExit:
+            operationIndex++;
+            nextOperation();
+            return;
+        default:
+            return;
+    }
+}
+
+void FlashDownload::fail(const char *reason) {
+    state = FlashFailed;
+    TimerScheduler::getInstance()->cancel(&retryTask);
+    compressedStream.close();
+    transferCrc.reset();
+    endTime = TimerScheduler::now();
+    cclPrintf("FlashDownload 0x%X 下载失败：%s，已确认 %llu 字节", node->diagConfig->PhyAddr, reason, confirmed);
+}
+
+bool FlashDownload::onEvent(EventType type, void *event) {
+//    只有等待压缩数据或校验 CRC 时才会挂起重试，sessionId 为0说明当前步骤的请求还没有发出
+    if (type != TimeEvent || static_cast<TimerEvent *>(event)->timerType != FlashTimer || sessionId != 0) {
+        return false;
+    }
+    if (state == FlashTransferData) {
+        transferData();
+    } else if (state == FlashCheckMemory) {
+        routineControl(operations[operationIndex]);
+    }
+    return false;
+}
+
+void FlashDownload::run() {
+}
+
+void FlashDownload::onFinished(DiagSession *session) {
+    auto it = nodeMap.find(session->nodeHandle);
+    if (it == nodeMap.end()) {
+        return;
+    }
+    FlashDownload *flashDownload = it->second->flashDownload;
+    if (flashDownload != nullptr && flashDownload->sessionId != 0 && flashDownload->sessionId == session->id) {
+        flashDownload->onResponse(session);
+    }
+}
+
+ObjectPool<FlashDownload> &FlashDownload::pool() {
+    static ObjectPool<FlashDownload> downloadPool;
+    return downloadPool;
+}
+
+FlashDownload *FlashDownload::acquire(uint16_t NodeHandle) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return nullptr;
+    }
+    Node *node = nodeMap[NodeHandle];
+    if (node->flashDownload == nullptr) {
+        node->flashDownload = pool().create(node);
+    }
+    FlashDownload *flashDownload = node->flashDownload;
+    if (flashDownload->running()) {
+        cclPrintf("FlashDownload 0x%X 上一次下载尚未结束", node->diagConfig->PhyAddr);
+        return nullptr;
+    }
+    return flashDownload;
+}
+
+int8_t FlashDownload::start() {
+    operationIndex = 0;
+    offset = 0;
+    confirmed = 0;
+    blockLength = 0;
+    pendingLength = 0;
+    blockSequenceCounter = 0;
+    blockCount = 0;
+    uncompressedLength = 0;
+    compressedLength = 0;
+    compressionStalls = 0;
+    startTime = TimerScheduler::now();
+    endTime = 0;
+    nextOperation();
+    return state == FlashFailed ? 0 : 1;
+}
+
+int8_t FlashDownload::startDownload(uint16_t NodeHandle, char *filePath, uint32_t memoryAddress) {
+    FlashDownload *flashDownload = acquire(NodeHandle);
+    if (flashDownload == nullptr) {
+        return 0;
+    }
+//    段的 CRC 在后台计算，不等它算完就开始下载，只有校验步骤才等待
+    if (!flashDownload->image.load(filePath, memoryAddress)) {
+        flashDownload->state = FlashIdle;
+        return 0;
+    }
+    flashDownload->manifestPath.clear();
+    flashDownload->regionHashes.clear();
+    DeltaPlan::full(flashDownload->image, flashDownload->config().eraseRoutine != 0,
+                    flashDownload->config().checkRoutine != 0, &flashDownload->operations);
+    return flashDownload->start();
+}
+
+Node *FlashDownload::configurable(uint16_t NodeHandle) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return nullptr;
+    }
+    Node *node = nodeMap[NodeHandle];
+    if (node->flashDownload != nullptr && node->flashDownload->running()) {
+        cclPrintf("FlashDownload 0x%X 正在下载，不能修改刷写配置", node->diagConfig->PhyAddr);
+        return nullptr;
+    }
+    return node;
+}
+
+int8_t FlashDownload::configDelta(uint16_t NodeHandle, uint32_t regionSize, uint32_t eraseRoutine,
+                                  uint32_t checkRoutine, uint32_t sectorSize) {
+    Node *node = configurable(NodeHandle);
+    if (node == nullptr || eraseRoutine > 0xFFFF || checkRoutine > 0xFFFF) {
+        return 0;
+    }
+    regionSize = regionSize == 0 ? FLASH_DEFAULT_REGION_SIZE : regionSize;
+    sectorSize = sectorSize == 0 ? FLASH_DEFAULT_SECTOR_SIZE : sectorSize;
+//    区域按自身大小对齐划分，必须是2的幂且不小于扇区，否则擦除范围会切开扇区
+    if ((regionSize & (regionSize - 1)) != 0 || (sectorSize & (sectorSize - 1)) != 0 || regionSize < sectorSize) {
+        cclPrintf("FlashDownload::configDelta 区域大小 0x%X 必须是2的幂且不小于扇区大小 0x%X", regionSize, sectorSize);
+        return 0;
+    }
+    FlashConfig &flashConfig = node->diagConfig->flashConfig;
+    flashConfig.regionSize = regionSize;
+    flashConfig.eraseRoutine = static_cast<uint16_t>(eraseRoutine);
+    flashConfig.checkRoutine = static_cast<uint16_t>(checkRoutine);
+    return 1;
+}
+
+int8_t FlashDownload::configCompression(uint16_t NodeHandle, uint32_t compressionMethod) {
+    Node *node = configurable(NodeHandle);
+    if (node == nullptr || compressionMethod > 0x0F) {
+        return 0;
+    }
+    node->diagConfig->flashConfig.compressionMethod = static_cast<uint8_t>(compressionMethod);
+    return 1;
+}
+
+int32_t FlashDownload::getCompressionRatio(uint16_t NodeHandle) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return -1;
+    }
+    FlashDownload *flashDownload = nodeMap[NodeHandle]->flashDownload;
+    if (flashDownload == nullptr || flashDownload->uncompressedLength == 0) {
+        return 0;
+    }
+    return static_cast<int32_t>(flashDownload->compressedLength * 1000 / flashDownload->uncompressedLength);
+}
+
+int8_t FlashDownload::startDeltaDownload(uint16_t NodeHandle, char *filePath, char *referencePath,
+                                         uint32_t memoryAddress) {
+    FlashDownload *flashDownload = acquire(NodeHandle);
+    if (flashDownload == nullptr) {
+        return 0;
+    }
+    if (!flashDownload->image.load(filePath, memoryAddress)) {
+        flashDownload->state = FlashIdle;
+        return 0;
+    }
+    uint32_t regionSize = flashDownload->config().regionSize;
+    DeltaPlan::hashRegions(flashDownload->image, regionSize, &flashDownload->regionHashes);
+    std::string reference = referencePath == nullptr ? "" : referencePath;
+    std::vector<RegionHash> referenceHashes;
+    bool hasReference = false;
+    flashDownload->manifestPath.clear();
+    if (reference.size() > strlen(FLASH_MANIFEST_EXTENSION)
+        && reference.compare(reference.size() - strlen(FLASH_MANIFEST_EXTENSION), std::string::npos,
+                             FLASH_MANIFEST_EXTENSION) == 0) {
+        hasReference = DeltaPlan::readManifest(reference, regionSize, &referenceHashes);
+//        先删除旧清单，中途失败时 ECU 内容未知，下一次按全部有变化处理
+        std::remove(reference.c_str());
+        flashDownload->manifestPath = reference;
+    } else if (!reference.empty()) {
+//        参考镜像只用来算区域哈希，不计算段 CRC、不写缓存，析构时也没有后台任务要等
+        FlashImage referenceImage;
+        hasReference = referenceImage.load(reference.c_str(), memoryAddress, true);
+        if (hasReference) {
+            DeltaPlan::hashRegions(referenceImage, regionSize, &referenceHashes);
+        }
+    }
+    if (!reference.empty() && !hasReference) {
+        cclPrintf("FlashDownload 0x%X 参考 %s 无效，所有区域按有变化处理", flashDownload->node->diagConfig->PhyAddr,
+                  reference.c_str());
+    }
+    DeltaPlan::delta(flashDownload->image, regionSize, flashDownload->regionHashes,
+                     hasReference ? &referenceHashes : nullptr, flashDownload->config().eraseRoutine != 0,
+                     flashDownload->config().checkRoutine != 0, &flashDownload->operations, &flashDownload->deltaStatistics);
+    return flashDownload->start();
+}
+
+int32_t FlashDownload::getDownloadStatus(uint16_t NodeHandle) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return -1;
+    }
+    FlashDownload *flashDownload = nodeMap[NodeHandle]->flashDownload;
+    return flashDownload == nullptr ? FlashIdle : flashDownload->state;
+}
+
+int32_t FlashDownload::getDownloadProgress(uint16_t NodeHandle) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return -1;
+    }
+    FlashDownload *flashDownload = nodeMap[NodeHandle]->flashDownload;
+    return flashDownload == nullptr ? 0 : static_cast<int32_t>(flashDownload->confirmed);
+}
+
+
+const FlashImage *FlashDownload::loadedImage(uint16_t NodeHandle) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end() || nodeMap[NodeHandle]->flashDownload == nullptr) {
+        return nullptr;
+    }
+    const FlashImage *image = &nodeMap[NodeHandle]->flashDownload->image;
+    return image->segmentCount() == 0 ? nullptr : image;
+}
+
+int32_t FlashDownload::getSegmentCount(uint16_t NodeHandle) {
+    const FlashImage *image = loadedImage(NodeHandle);
+    return image == nullptr ? -1 : static_cast<int32_t>(image->segmentCount());
+}
+
+uint32_t FlashDownload::getSegmentAddress(uint16_t NodeHandle, uint32_t index) {
+    const FlashImage *image = loadedImage(NodeHandle);
+    return image == nullptr || index >= image->segmentCount() ? 0 : image->segment(index).address;
+}
+
+uint32_t FlashDownload::getSegmentLength(uint16_t NodeHandle, uint32_t index) {
+    const FlashImage *image = loadedImage(NodeHandle);
+    return image == nullptr || index >= image->segmentCount() ? 0 : image->segment(index).length;
+}
+
+int32_t FlashDownload::getSegmentCrc(uint16_t NodeHandle, uint32_t index, uint32_t *crc) {
+    const FlashImage *image = loadedImage(NodeHandle);
+    if (image == nullptr || index >= image->segmentCount()) {
+        return 0;
+    }
+    return image->tryCrc(index, crc) ? 1 : -1;
+}
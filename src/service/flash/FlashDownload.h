@@ -0,0 +1,181 @@
+﻿#ifndef DLLTEST_FLASHDOWNLOAD_H
+#define DLLTEST_FLASHDOWNLOAD_H
+
+#include <vector>
+#include "FlashImage.h"
+#include "DeltaPlan.h"
+#include "CompressedStream.h"
+#include "IncrementalCrc.h"
+#include "../event/EventListener.h"
+#include "../timer/TimerScheduler.h"
+#include "../../model/vo/DiagV0.h"
+#include "../../model/vo/ObjectPool.h"
+#include "../../model/entity/Node.h"
+
+// 后台任务尚未完成时，隔多久再尝试下一个请求，单位 ms
+#define FLASH_RETRY_INTERVAL 1
+
+enum FlashDownloadState {
+    FlashIdle = 0,
+    FlashRequestDownload = 1,  // 已发出 0x34，等待 0x74
+    FlashTransferData = 2,     // 已发出 0x36，等待 0x76
+    FlashTransferExit = 3,     // 已发出 0x37，等待 0x77
+    FlashFinished = 4,
+    FlashFailed = 5,
+    FlashEraseMemory = 6,      // 已发出擦除例程 0x31，等待 0x71
+    FlashCheckMemory = 7,      // 已发出校验例程 0x31，等待 0x71
+};
+
+
+/*
+ * FlashDownload  刷写下载流程，镜像的每一段依次 RequestDownload(0x34) -> TransferData(0x36)... -> RequestTransferExit(0x37)
+ * 每个节点一个，TransferData 的数据直接引用 FlashImage 的段数据，会话只保存 36 SN 两字节请求头
+ * 块长度取 0x74 响应中的 maxNumberOfBlockLength(包含 SID 和块序号)，块序号从 1 开始，0xFF 之后回到 0x00
+ * 每个请求结束时由 DiagCompletion 通知，收到正响应立即发出下一块，整个下载过程不需要 CAPL 参与
+ * 下载前由 DeltaPlan 生成擦除/下载/校验步骤，整段下载时每段一次 34/36/37，增量下载时只处理有变化的区域
+ * 配置了压缩方式时 0x34 的 dataFormatIdentifier 高4位为压缩方式，0x36 发送 CompressedStream 提前压缩好的 LZ4 帧；
+ * 下一块还没压缩完时不在 CANoe 线程上等待，FLASH_RETRY_INTERVAL 后由 TimerScheduler 回调再发
+ * 校验例程的 CRC 不在 CANoe 线程上计算：整段校验用镜像加载时后台算好的段 CRC，增量下载的范围由 IncrementalCrc
+ * 随发送在工作线程上计算，其他范围也交给 IncrementalCrc；CRC 尚未算完时由 TimerScheduler 回调稍后再发 0x31
+ * */
+class FlashDownload : public EventListener {
+private:
+    Node *node;
+    TimerTask retryTask;
+    FlashImage image;
+//    在 image 之后声明，先于镜像析构；压缩和 CRC 任务持有镜像数据的引用，关闭流或重置 CRC 时不等待它们
+    CompressedStream compressedStream;
+    IncrementalCrc transferCrc;
+//    transferCrc 覆盖的地址范围，即最近一次完成的下载步骤
+    uint32_t transferCrcAddress = 0;
+    uint32_t transferCrcLength = 0;
+    std::vector<FlashOperation> operations;
+    uint32_t operationIndex = 0;       // 正在执行的步骤
+    uint64_t offset = 0;               // 当前下载步骤中已被 ECU 确认的字节数
+    uint64_t confirmed = 0;            // 所有段中已被 ECU 确认的原始字节数，压缩时由确认的压缩数据折算
+    uint32_t blockLength = 0;          // 每个 TransferData 携带的数据长度
+    uint32_t pendingLength = 0;        // 正在发送的块的数据长度
+    uint8_t blockSequenceCounter = 0;  // 最近一次发出的块序号
+    uint32_t blockCount = 0;
+    uint32_t sessionId = 0;            // 正在等待的诊断ID
+    FlashDownloadState state = FlashIdle;
+    long long startTime = 0;
+    long long endTime = 0;
+//    下载成功后保存区域哈希的清单路径，为空时不保存
+    std::string manifestPath;
+    std::vector<RegionHash> regionHashes;
+    DeltaStatistics deltaStatistics;
+    uint64_t uncompressedLength = 0;   // 已完成的下载步骤的原始字节数
+    uint64_t compressedLength = 0;     // 已完成的下载步骤实际传输的字节数
+    uint64_t compressionStalls = 0;
+
+    [[nodiscard]] bool running() const {
+        return state == FlashRequestDownload || state == FlashTransferData || state == FlashTransferExit
+               || state == FlashEraseMemory || state == FlashCheckMemory;
+    }
+
+//    开始下一步，全部完成时结束下载
+    void nextOperation();
+
+    void requestDownload();
+
+//    发出下一块；压缩数据尚未准备好时稍后重试
+    void transferData();
+
+    void transferExit();
+
+//    RoutineControl(0x31 01) 擦除或校验 operation 的地址范围；校验的 CRC 尚未算完时稍后重试
+    void routineControl(const FlashOperation &operation);
+
+//    取校验步骤的 CRC，尚未算完时返回 false，不等待
+    bool checkCrc(const FlashOperation &operation, uint32_t *crc);
+
+//    FLASH_RETRY_INTERVAL 后重新执行当前步骤
+    void retryLater();
+
+    void finish();
+
+    void onResponse(DiagSession *session);
+
+    void fail(const char *reason);
+
+//    从 0x74 响应中取 maxNumberOfBlockLength，格式错误返回 0
+    static uint32_t maxNumberOfBlockLength(const std::vector<uint8_t> &response);
+
+//    节点最近一次加载的镜像，不存在时返回空
+    static const FlashImage *loadedImage(uint16_t NodeHandle);
+
+//    取节点的下载对象，第一次使用时生成；节点不存在或正在下载时返回空
+    static FlashDownload *acquire(uint16_t NodeHandle);
+
+//    可以修改刷写配置的节点，节点不存在或正在下载时返回空
+    static Node *configurable(uint16_t NodeHandle);
+
+    [[nodiscard]] const FlashConfig &config() const {
+        return node->diagConfig->flashConfig;
+    }
+
+//    重置进度并执行第一步
+    int8_t start();
+
+public:
+    explicit FlashDownload(Node *node) {
+        this->node = node;
+        retryTask.listener = this;
+        retryTask.timerType = FlashTimer;
+    }
+
+    bool onEvent(EventType type, void *event) override;
+
+    void run() override;
+
+//    诊断结束，由 DiagCompletion::notify 调用，属于下载流程的请求推进到下一步
+    static void onFinished(DiagSession *session);
+
+//    本次测量的下载对象池，测量结束时统一释放并关闭镜像映射
+    static ObjectPool<FlashDownload> &pool();
+
+//    加载镜像文件并开始下载，memoryAddress 只用于原始二进制；节点不存在、正在下载或文件无法加载时返回0
+    static int8_t startDownload(uint16_t NodeHandle, char *filePath, uint32_t memoryAddress);
+
+//    配置增量刷写：区域大小、擦除例程ID、校验例程ID、ECU 擦除扇区大小，大小为0使用默认值，例程ID为0表示不支持
+//    区域大小必须是2的幂且不小于扇区大小，否则返回0
+    static int8_t configDelta(uint16_t NodeHandle, uint32_t regionSize, uint32_t eraseRoutine,
+                              uint32_t checkRoutine, uint32_t sectorSize);
+
+//    增量下载：与参考逐区域比较，只擦除/下载有变化的区域
+//    referencePath 为 .fhash 清单(上一次成功刷写时保存，下载成功后用新镜像覆盖)或参考镜像文件，为空时全部视为有变化
+    static int8_t startDeltaDownload(uint16_t NodeHandle, char *filePath, char *referencePath,
+                                     uint32_t memoryAddress);
+
+//    最近一次加载的镜像的段数，节点不存在或未加载返回-1
+    static int32_t getSegmentCount(uint16_t NodeHandle);
+
+//    第 index 段的起始地址，不存在返回0
+    static uint32_t getSegmentAddress(uint16_t NodeHandle, uint32_t index);
+
+//    第 index 段的长度，不存在返回0
+    static uint32_t getSegmentLength(uint16_t NodeHandle, uint32_t index);
+
+//    第 index 段的 CRC32 写入 crc 并返回1；后台尚未算完时返回-1，不等待，稍后再取；段不存在返回0
+    static int32_t getSegmentCrc(uint16_t NodeHandle, uint32_t index, uint32_t *crc);
+
+//    下载状态 FlashDownloadState，节点不存在返回-1
+    static int32_t getDownloadStatus(uint16_t NodeHandle);
+
+//    配置下载数据的压缩方式(dataFormatIdentifier 高4位，1~15)，0 表示不压缩
+    static int8_t configCompression(uint16_t NodeHandle, uint32_t compressionMethod);
+
+//    最近一次下载的压缩率，压缩后字节数 / 原始字节数 * 1000，没有数据返回0，节点不存在返回-1
+    static int32_t getCompressionRatio(uint16_t NodeHandle);
+
+//    已被 ECU 确认的原始字节数，压缩时由确认的压缩数据折算，与镜像长度可直接比较；节点不存在返回-1
+    static int32_t getDownloadProgress(uint16_t NodeHandle);
+
+    ~FlashDownload() {
+        TimerScheduler::getInstance()->cancel(&retryTask);
+    }
+};
+
+
+#endif //DLLTEST_FLASHDOWNLOAD_H
@@ -0,0 +1,396 @@
+﻿#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include "FlashImage.h"
+#include "HexDecoder.h"
+#include "Crc32.h"
+#include "BlockHash.h"
+
+// 缓存文件 "FIMG"，格式变化时递增版本号
+#define FLASH_IMAGE_CACHE_MAGIC 0x474D4946u
+#define FLASH_IMAGE_CACHE_VERSION 1u
+
+// 缓存文件头，其后依次为段表和段数据
+typedef struct FlashImageCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t segmentCount;
+    uint32_t reserved;
+} FlashImageCacheHeader;
+
+typedef struct FlashImageCacheSegment {
+    uint32_t address;
+    uint32_t length;
+    uint64_t offset;  // 相对段数据起始位置
+    uint32_t crc32;
+    uint32_t reserved;
+} FlashImageCacheSegment;
+
+enum FlashImageFormat {
+    BinaryFormat,
+    IntelHexFormat,
+    SRecordFormat,
+};
+
+static FlashImageFormat imageFormat(const char *path) {
+    std::string extension = path;
+    size_t dot = extension.find_last_of('.');
+    extension = dot == std::string::npos ? "" : extension.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == "hex" || extension == "ihex") {
+        return IntelHexFormat;
+    }
+    if (extension == "s19" || extension == "s28" || extension == "s37" || extension == "srec" || extension == "mot") {
+        return SRecordFormat;
+    }
+    return BinaryFormat;
+}
+
+// 依次取出每一行，去掉行尾的 \r 和空白，空行跳过
+template<class Handler>
+static bool forEachLine(const char *text, uint64_t length, Handler handler) {
+    const char *end = text + length;
+    uint32_t lineNumber = 0;
+    for (const char *line = text; line < end;) {
+        auto *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+        const char *next = lineEnd == nullptr ? end : lineEnd + 1;
+        lineEnd = lineEnd == nullptr ? end : lineEnd;
+        lineNumber++;
+        while (lineEnd > line && (lineEnd[-1] == '\r' || lineEnd[-1] == ' ' || lineEnd[-1] == '\t')) {
+            lineEnd--;
+        }
+        if (lineEnd > line) {
+            int result = handler(line, static_cast<uint32_t>(lineEnd - line));
+            if (result < 0) {
+                cclPrintf("FlashImage 第 %u 行格式错误", lineNumber);
+                return false;
+            }
+//            结束记录之后的内容忽略
+            if (result > 0) {
+                return true;
+            }
+        }
+        line = next;
+    }
+    return true;
+}
+
+bool FlashImage::parseIntelHex(const char *text, uint64_t length) {
+    uint8_t record[5 + 255];
+    uint32_t baseAddress = 0;
+//    返回 -1 格式错误，0 继续，1 结束
+    return forEachLine(text, length, [&](const char *line, uint32_t lineLength) {
+        uint32_t chars = lineLength - 1;
+        if (line[0] != ':' || chars < 10 || chars % 2 != 0 || chars > sizeof(record) * 2
+            || !decodeHex(line + 1, chars, record)) {
+            return -1;
+        }
+        uint32_t recordLength = chars / 2;
+        uint8_t count = record[0];
+        if (recordLength != count + 5u) {
+            return -1;
+        }
+//        所有字节(包括校验和)相加为0
+        uint8_t sum = 0;
+        for (uint32_t i = 0; i < recordLength; ++i) {
+            sum += record[i];
+        }
+        if (sum != 0) {
+            return -1;
+        }
+        uint16_t address = record[1] << 8 | record[2];
+        const uint8_t *data = record + 4;
+        switch (record[3]) {
+            case 0x00:
+                append(baseAddress + address, data, count);
+                return 0;
+            case 0x01:
+                return 1;
+            case 0x02:
+                if (count != 2) {
+                    return -1;
+                }
+                baseAddress = static_cast<uint32_t>(data[0] << 8 | data[1]) << 4;
+                return 0;
+            case 0x04:
+                if (count != 2) {
+                    return -1;
+                }
+                baseAddress = static_cast<uint32_t>(data[0] << 8 | data[1]) << 16;
+                return 0;
+            case 0x03:
+            case 0x05:
+//                起始地址与下载无关
+                return 0;
+            default:
+                return -1;
+        }
+    });
+}
+
+bool FlashImage::parseSRecord(const char *text, uint64_t length) {
+    uint8_t record[1 + 255];
+//    S0~S9 的地址字节数，S4 保留
+    static const uint8_t ADDRESS_LENGTH[10] = {2, 2, 3, 4, 0, 2, 3, 4, 3, 2};
+    return forEachLine(text, length, [&](const char *line, uint32_t lineLength) {
+        uint32_t chars = lineLength - 2;
+        if (lineLength < 4 || line[0] != 'S' || line[1] < '0' || line[1] > '9' || line[1] == '4'
+            || chars % 2 != 0 || chars > sizeof(record) * 2 || !decodeHex(line + 2, chars, record)) {
+            return -1;
+        }
+        uint8_t type = line[1] - '0';
+        uint32_t recordLength = chars / 2;
+        uint8_t count = record[0];
+        uint8_t addressLength = ADDRESS_LENGTH[type];
+        if (recordLength != count + 1u || count < addressLength + 1u) {
+            return -1;
+        }
+//        长度、地址、数据和校验和相加为 0xFF
+        uint8_t sum = 0;
+        for (uint32_t i = 0; i < recordLength; ++i) {
+            sum += record[i];
+        }
+        if (sum != 0xFF) {
+            return -1;
+        }
+        if (type >= 7) {
+            return 1;
+        }
+        if (type == 0 || type == 5 || type == 6) {
+            return 0;
+        }
+        uint32_t address = 0;
+        for (uint8_t i = 0; i < addressLength; ++i) {
+            address = address << 8 | record[1 + i];
+        }
+        append(address, record + 1 + addressLength, count - addressLength - 1);
+        return 0;
+    });
+}
+
+void FlashImage::append(uint32_t address, const uint8_t *data, uint32_t length) {
+    if (length == 0) {
+        return;
+    }
+//    记录通常按地址顺序排列，接在上一段末尾时直接延长
+    if (!segments.empty()) {
+        FlashSegment &last = segments.back();
+        if (last.address + last.length == address && last.offset + last.length == storage->buffer.size()) {
+            last.length += length;
+            storage->buffer.insert(storage->buffer.end(), data, data + length);
+            return;
+        }
+    }
+    segments.push_back({address, length, storage->buffer.size()});
+    storage->buffer.insert(storage->buffer.end(), data, data + length);
+}
+
+bool FlashImage::normalize() {
+    bool sorted = true;
+    for (size_t i = 1; i < segments.size(); ++i) {
+        if (segments[i].address < static_cast<uint64_t>(segments[i - 1].address) + segments[i - 1].length) {
+            sorted = false;
+            break;
+        }
+    }
+    if (sorted) {
+        return true;
+    }
+//    乱序的记录按地址重新排列段数据
+    std::vector<uint32_t> order(segments.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return segments[a].address < segments[b].address;
+    });
+    std::vector<FlashSegment> sortedSegments;
+    std::vector<uint8_t> sortedBuffer;
+    sortedBuffer.reserve(storage->buffer.size());
+    for (uint32_t index: order) {
+        const FlashSegment &segment = segments[index];
+        const uint8_t *data = storage->buffer.data() + segment.offset;
+        if (!sortedSegments.empty()) {
+            FlashSegment &last = sortedSegments.back();
+            uint64_t lastEnd = static_cast<uint64_t>(last.address) + last.length;
+            if (segment.address < lastEnd) {
+                cclPrintf("FlashImage 地址 0x%08X 处的数据重叠", segment.address);
+                return false;
+            }
+            if (segment.address == lastEnd) {
+                last.length += segment.length;
+                sortedBuffer.insert(sortedBuffer.end(), data, data + segment.length);
+                continue;
+            }
+        }
+        sortedSegments.push_back({segment.address, segment.length, sortedBuffer.size()});
+        sortedBuffer.insert(sortedBuffer.end(), data, data + segment.length);
+    }
+    segments.swap(sortedSegments);
+    storage->buffer.swap(sortedBuffer);
+    return true;
+}
+
+void FlashImage::computeChecksums() {
+//    线程池已停止时提交的任务不会执行，取 CRC 会一直等下去，改为当场计算
+    bool background = ThreadPool::getInstance()->running();
+    for (uint32_t i = 0; i < segments.size(); ++i) {
+        const uint8_t *data = segmentData(i);
+        uint32_t length = segments[i].length;
+        if (!background) {
+            std::promise<uint32_t> checksum;
+            checksum.set_value(crc32(data, length));
+            checksums.push_back(checksum.get_future().share());
+            continue;
+        }
+        checksums.push_back(ThreadPool::getInstance()->submit([data, length, retained = storage] {
+            return crc32(data, length);
+        }).share());
+    }
+}
+
+void FlashImage::writeCache(const std::string &cachePath, uint64_t sourceHash, uint64_t sourceSize) {
+    if (!ThreadPool::getInstance()->running()) {
+        saveCache(cachePath, sourceHash, sourceSize, segments, checksums, storage->buffer);
+        return;
+    }
+//    CRC 任务排在前面，这里等待时它们已经被工作线程取走；段表和 CRC 拷贝一份，镜像随后关闭也不影响
+    ThreadPool::getInstance()->enqueue([cachePath, sourceHash, sourceSize, segments = segments,
+                                               checksums = checksums, retained = storage] {
+        saveCache(cachePath, sourceHash, sourceSize, segments, checksums, retained->buffer);
+    });
+}
+
+void FlashImage::saveCache(const std::string &cachePath, uint64_t sourceHash, uint64_t sourceSize,
+                           const std::vector<FlashSegment> &segments,
+                           const std::vector<std::shared_future<uint32_t>> &checksums,
+                           const std::vector<uint8_t> &buffer) {
+    std::string tempPath = cachePath + "." + std::to_string(reinterpret_cast<uintptr_t>(&buffer)) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        FlashImageCacheHeader header = {FLASH_IMAGE_CACHE_MAGIC, FLASH_IMAGE_CACHE_VERSION, sourceHash,
+                                        sourceSize, static_cast<uint32_t>(segments.size()), 0};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (uint32_t i = 0; i < segments.size(); ++i) {
+            FlashImageCacheSegment entry = {segments[i].address, segments[i].length, segments[i].offset,
+                                            checksums[i].get(), 0};
+            file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+        }
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        if (!file.good()) {
+            file.close();
+            std::remove(tempPath.c_str());
+            return;
+        }
+    }
+//    缓存正被其他节点映射时无法替换，保留旧缓存，下次加载时重新解析
+    std::remove(cachePath.c_str());
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+    }
+}
+
+bool FlashImage::loadCache(const std::string &cachePath, uint64_t sourceHash, uint64_t sourceSize) {
+    if (!storage->mapping.open(cachePath.c_str())) {
+        return false;
+    }
+    FlashImageCacheHeader header{};
+    if (storage->mapping.size() >= sizeof(header)) {
+        memcpy(&header, storage->mapping.data(), sizeof(header));
+    }
+    uint64_t dataStart = sizeof(header) + static_cast<uint64_t>(header.segmentCount) * sizeof(FlashImageCacheSegment);
+    if (header.magic != FLASH_IMAGE_CACHE_MAGIC || header.version != FLASH_IMAGE_CACHE_VERSION
+        || header.sourceHash != sourceHash || header.sourceSize != sourceSize || header.segmentCount == 0
+        || storage->mapping.size() < dataStart) {
+        storage->mapping.close();
+        return false;
+    }
+    uint64_t dataLength = storage->mapping.size() - dataStart;
+    for (uint32_t i = 0; i < header.segmentCount; ++i) {
+        FlashImageCacheSegment entry{};
+        memcpy(&entry, storage->mapping.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+        if (entry.offset + entry.length > dataLength) {
+            segments.clear();
+            checksums.clear();
+            storage->mapping.close();
+            return false;
+        }
+        segments.push_back({entry.address, entry.length, entry.offset});
+        std::promise<uint32_t> checksum;
+        checksum.set_value(entry.crc32);
+        checksums.push_back(checksum.get_future().share());
+    }
+    base = storage->mapping.data() + dataStart;
+    fromCache = true;
+    return true;
+}
+
+bool FlashImage::loadBinary(const char *path, uint32_t memoryAddress, bool hashOnly) {
+    if (!storage->mapping.open(path)) {
+        cclPrintf("FlashImage 无法映射镜像文件 %s", path);
+        return false;
+    }
+    if (storage->mapping.size() > UINT32_MAX) {
+        storage->mapping.close();
+        cclPrintf("FlashImage 镜像文件 %s 超过 4GB", path);
+        return false;
+    }
+    segments.push_back({memoryAddress, static_cast<uint32_t>(storage->mapping.size()), 0});
+    base = storage->mapping.data();
+    if (!hashOnly) {
+        computeChecksums();
+    }
+    return true;
+}
+
+bool FlashImage::load(const char *path, uint32_t memoryAddress, bool hashOnly) {
+    close();
+    storage = std::make_shared<FlashImageData>();
+    FlashImageFormat format = imageFormat(path);
+    if (format == BinaryFormat) {
+        return loadBinary(path, memoryAddress, hashOnly);
+    }
+    MappedFile source;
+    if (!source.open(path)) {
+        cclPrintf("FlashImage 无法映射镜像文件 %s", path);
+        return false;
+    }
+    uint64_t sourceHash = hashBytes(source.data(), source.size());
+    std::string cachePath = std::string(path) + ".fimg";
+    if (loadCache(cachePath, sourceHash, source.size())) {
+        return true;
+    }
+//    数据字节数不超过字符数的一半，一次预留，解析过程中不再扩容
+    storage->buffer.reserve(source.size() / 2);
+    const char *text = reinterpret_cast<const char *>(source.data());
+    bool result = format == IntelHexFormat ? parseIntelHex(text, source.size()) : parseSRecord(text, source.size());
+    if (!result || !normalize() || segments.empty()) {
+        cclPrintf("FlashImage 解析 %s 失败", path);
+        close();
+        return false;
+    }
+    base = storage->buffer.data();
+    if (!hashOnly) {
+        computeChecksums();
+        writeCache(cachePath, sourceHash, source.size());
+    }
+    return true;
+}
+
+void FlashImage::close() {
+//    后台的 CRC 和缓存任务持有数据的引用，这里只放下镜像自己的引用，不等待它们
+    checksums.clear();
+    segments.clear();
+    storage.reset();
+    base = nullptr;
+    fromCache = false;
+}
+
+uint64_t FlashImage::totalLength() const {
+    uint64_t length = 0;
+    for (const FlashSegment &segment: segments) {
+        length += segment.length;
+    }
+    return length;
+}
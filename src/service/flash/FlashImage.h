@@ -0,0 +1,122 @@
+﻿#ifndef DLLTEST_FLASHIMAGE_H
+#define DLLTEST_FLASHIMAGE_H
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// 镜像中一段连续地址的数据
+typedef struct FlashSegment {
+    uint32_t address = 0;
+    uint32_t length = 0;
+    uint64_t offset = 0;  // 在镜像数据中的偏移
+} FlashSegment;
+
+// 镜像数据的存储，后台任务持有它的引用，镜像关闭或重新加载后数据在最后一个任务结束时才释放
+typedef struct FlashImageData {
+    MappedFile mapping;             // 原始二进制或缓存文件
+    std::vector<uint8_t> buffer;    // 本次解析得到的段数据
+} FlashImageData;
+
+/*
+ * FlashImage  刷写镜像，按地址排序的稀疏段表 + 连续存放的段数据
+ * .hex(Intel HEX) 和 .s19/.s28/.s37/.srec/.mot(Motorola S-record) 映射后逐行解析一遍，数据字段按 8 字符一组并行解码；
+ * 其他扩展名按原始二进制处理，整个文件为一段，直接使用映射
+ * 每段的 CRC32 在 ThreadPool 上计算，加载返回后即可开始下载；线程池未运行(测量结束后)时在加载时直接算完
+ * 解析结果连同 CRC 写入源文件旁的 .fimg 缓存，以源文件内容的哈希为键，源文件不变时下次直接映射缓存，不再解析
+ * 后台任务持有数据的引用，关闭和重新加载都不等待它们结束；只用来算区域哈希的参考镜像可以跳过 CRC 和缓存
+ * */
+class FlashImage {
+private:
+    std::vector<FlashSegment> segments;
+    std::vector<std::shared_future<uint32_t>> checksums;
+    std::shared_ptr<FlashImageData> storage;
+    const uint8_t *base = nullptr;  // 段数据起始位置
+    bool fromCache = false;
+
+    bool loadBinary(const char *path, uint32_t memoryAddress, bool hashOnly);
+
+    bool loadCache(const std::string &cachePath, uint64_t sourceHash, uint64_t sourceSize);
+
+    bool parseIntelHex(const char *text, uint64_t length);
+
+    bool parseSRecord(const char *text, uint64_t length);
+
+    void append(uint32_t address, const uint8_t *data, uint32_t length);
+
+//    段按地址排序并合并相邻段，地址重叠时返回 false
+    bool normalize();
+
+//    每段一个任务计算 CRC32
+    void computeChecksums();
+
+//    CRC 算完后在 ThreadPool 上写缓存文件，线程池未运行时直接写
+    void writeCache(const std::string &cachePath, uint64_t sourceHash, uint64_t sourceSize);
+
+//    写缓存文件，先写临时文件再改名；在工作线程上执行，只使用传入的段表、CRC 和数据
+    static void saveCache(const std::string &cachePath, uint64_t sourceHash, uint64_t sourceSize,
+                          const std::vector<FlashSegment> &segments,
+                          const std::vector<std::shared_future<uint32_t>> &checksums,
+                          const std::vector<uint8_t> &buffer);
+
+public:
+    FlashImage() = default;
+
+//    禁止拷贝构造
+    FlashImage(const FlashImage &flashImage) = delete;
+
+    FlashImage &operator=(const FlashImage &flashImage) = delete;
+
+//    按扩展名加载镜像，memoryAddress 只用于原始二进制
+//    hashOnly 为 true 时只加载数据，不计算段 CRC 也不写缓存，tryCrc 始终返回 false，用于增量刷写的参考镜像
+    bool load(const char *path, uint32_t memoryAddress, bool hashOnly = false);
+
+//    释放数据，不等待后台任务；任务仍在使用的数据由它们持有的引用保持有效
+    void close();
+
+    [[nodiscard]] uint32_t segmentCount() const {
+        return static_cast<uint32_t>(segments.size());
+    }
+
+    [[nodiscard]] const FlashSegment &segment(uint32_t index) const {
+        return segments[index];
+    }
+
+    [[nodiscard]] const uint8_t *segmentData(uint32_t index) const {
+        return base + segments[index].offset;
+    }
+
+    [[nodiscard]] uint64_t totalLength() const;
+
+//    第 index 段的 CRC32，尚未算完时等待，只在工作线程上调用
+    [[nodiscard]] uint32_t crc(uint32_t index) const {
+        return checksums[index].get();
+    }
+
+//    第 index 段的 CRC32 已算完时写入 checksum 并返回 true，尚未算完时立即返回 false，供 CANoe 线程调用
+    bool tryCrc(uint32_t index, uint32_t *checksum) const {
+        if (index >= checksums.size() || checksums[index].wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+        *checksum = checksums[index].get();
+        return true;
+    }
+
+//    数据的引用，提交到工作线程的任务持有它，镜像关闭或重新加载后任务读取的数据仍然有效
+    [[nodiscard]] std::shared_ptr<const void> retain() const {
+        return storage;
+    }
+
+    [[nodiscard]] bool isCached() const {
+        return fromCache;
+    }
+
+    ~FlashImage() {
+        close();
+    }
+};
+
+
+#endif //DLLTEST_FLASHIMAGE_H
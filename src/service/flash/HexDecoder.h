@@ -0,0 +1,77 @@
+﻿#ifndef DLLTEST_HEXDECODER_H
+#define DLLTEST_HEXDECODER_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+// 十六进制字符 -> 半字节，非法字符为 0xF0，解码时 OR 到一起只需判断一次
+constexpr std::array<uint8_t, 256> HEX_NIBBLE = [] {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        if (c >= '0' && c <= '9') {
+            table[c] = c - '0';
+        } else if (c >= 'A' && c <= 'F') {
+            table[c] = c - 'A' + 10;
+        } else if (c >= 'a' && c <= 'f') {
+            table[c] = c - 'a' + 10;
+        } else {
+            table[c] = 0xF0;
+        }
+    }
+    return table;
+}();
+
+constexpr uint64_t SWAR_ONES = 0x0101010101010101ULL;
+
+// 每个字节是否满足 m < x < n，满足的字节最高位置1；高位为1的字节(非 ASCII)一律不满足
+constexpr uint64_t swarBetween(uint64_t x, uint8_t m, uint8_t n) {
+    return (SWAR_ONES * (127 + n) - (x & SWAR_ONES * 127)) & ~x & ((x & SWAR_ONES * 127) + SWAR_ONES * (127 - m))
+           & SWAR_ONES * 128;
+}
+
+/*
+ * 8 个十六进制字符 -> 4 字节，在 64 位寄存器内并行(SWAR)完成校验和转换，按小端读入
+ * 返回值每个合法字符对应的字节最高位为1，全部合法时等于 SWAR_ONES * 128
+ * */
+static inline uint64_t decodeHex8(const char *text, uint8_t *target) {
+    uint64_t x;
+    memcpy(&x, text, sizeof(x));
+//    字母统一转小写，数字的 bit5 本来就是1
+    uint64_t lower = x | SWAR_ONES * 0x20;
+    uint64_t valid = swarBetween(x, '0' - 1, '9' + 1) | swarBetween(lower, 'a' - 1, 'f' + 1);
+//    '0'~'9' 低4位即数值，'a'~'f' 低4位为1~6，bit6 为1时加9
+    uint64_t nibble = (lower & SWAR_ONES * 0x0F) + ((lower >> 6) & SWAR_ONES) * 9;
+//    相邻两个半字节合成一个字节，再把 4 个 16 位通道压缩到低 32 位
+    uint64_t packed = (nibble & 0x00FF00FF00FF00FFULL) << 4 | (nibble >> 8 & 0x00FF00FF00FF00FFULL);
+    packed = (packed | packed >> 8) & 0x0000FFFF0000FFFFULL;
+    packed = (packed | packed >> 16) & 0xFFFFFFFFULL;
+    auto value = static_cast<uint32_t>(packed);
+    memcpy(target, &value, sizeof(value));
+    return valid;
+}
+
+// 解码 length 个十六进制字符(偶数)，前面按 8 字符一组并行，剩余的查表；校验结果最后统一判断，循环内没有分支
+static inline bool decodeHex(const char *text, uint32_t length, uint8_t *target) {
+    uint64_t valid = SWAR_ONES * 128;
+    uint32_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        valid &= decodeHex8(text + i, target);
+        valid &= decodeHex8(text + i + 8, target + 4);
+        target += 8;
+    }
+    for (; i + 8 <= length; i += 8) {
+        valid &= decodeHex8(text + i, target);
+        target += 4;
+    }
+    uint8_t invalid = 0;
+    for (; i + 2 <= length; i += 2) {
+        uint8_t high = HEX_NIBBLE[static_cast<uint8_t>(text[i])];
+        uint8_t low = HEX_NIBBLE[static_cast<uint8_t>(text[i + 1])];
+        invalid |= high | low;
+        *target++ = static_cast<uint8_t>(high << 4 | (low & 0x0F));
+    }
+    return valid == SWAR_ONES * 128 && (invalid & 0xF0) == 0;
+}
+
+#endif //DLLTEST_HEXDECODER_H
@@ -0,0 +1,86 @@
+﻿#include "IncrementalCrc.h"
+
+void IncrementalCrc::flush(bool all) {
+    while (pendingLength >= INCREMENTAL_CRC_PIECE || (all && pendingLength > 0)) {
+        const uint8_t *data = pendingData;
+        uint64_t dataLength = pendingLength < INCREMENTAL_CRC_PIECE ? pendingLength : INCREMENTAL_CRC_PIECE;
+        if (cancelled == nullptr) {
+            cancelled = std::make_shared<std::atomic<bool>>(false);
+        }
+        pieces.push_back({ThreadPool::getInstance()->submit([data, dataLength, cancelled = cancelled,
+                                                                    retained = owner] {
+//            已被 reset 放弃，结果不会再被取走
+            if (cancelled->load(std::memory_order_relaxed)) {
+                return 0u;
+            }
+            return crc32(data, dataLength);
+        }), dataLength});
+        pendingData += dataLength;
+        pendingLength -= dataLength;
+    }
+    if (pendingLength == 0) {
+        pendingData = nullptr;
+    }
+}
+
+void IncrementalCrc::fold(bool wait) {
+    while (!pieces.empty()) {
+        CrcPiece &piece = pieces.front();
+        if (!wait && piece.crc.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+//        整片的合并算子只算一次，合并只需一次矩阵乘
+        static const std::array<uint32_t, 32> PIECE_ZEROS = [] {
+            std::array<uint32_t, 32> zeros{};
+            crc32ZerosOperator(INCREMENTAL_CRC_PIECE, zeros.data());
+            return zeros;
+        }();
+        if (piece.length == INCREMENTAL_CRC_PIECE) {
+            crc = crc32MatrixTimes(PIECE_ZEROS.data(), crc) ^ piece.crc.get();
+        } else {
+            crc = crc32Combine(crc, piece.crc.get(), piece.length);
+        }
+        pieces.pop_front();
+    }
+}
+
+void IncrementalCrc::update(const uint8_t *data, uint64_t dataLength) {
+    if (pendingLength > 0 && data != pendingData + pendingLength) {
+        flush(true);
+    }
+    if (pendingLength == 0) {
+        pendingData = data;
+    }
+    pendingLength += dataLength;
+    flush(false);
+    fold(false);
+}
+
+uint32_t IncrementalCrc::digest() {
+    flush(true);
+    fold(true);
+    return crc;
+}
+
+bool IncrementalCrc::tryDigest(uint32_t *digest) {
+    flush(true);
+    fold(false);
+    if (!pieces.empty()) {
+        return false;
+    }
+    *digest = crc;
+    return true;
+}
+
+void IncrementalCrc::reset(std::shared_ptr<const void> sourceOwner) {
+//    片任务持有自己的数据引用，丢弃 future 不会等待，只需通知它们不必再算
+    if (cancelled != nullptr) {
+        cancelled->store(true, std::memory_order_relaxed);
+        cancelled = nullptr;
+    }
+    pieces.clear();
+    owner = std::move(sourceOwner);
+    pendingData = nullptr;
+    pendingLength = 0;
+    crc = 0;
+}
@@ -0,0 +1,67 @@
+﻿#ifndef DLLTEST_INCREMENTALCRC_H
+#define DLLTEST_INCREMENTALCRC_H
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <memory>
+#include "Crc32.h"
+
+// 连续数据攒够这么多字节才提交一次 CRC 任务
+#define INCREMENTAL_CRC_PIECE 65536u
+
+/*
+ * IncrementalCrc  随发送进度计算的 CRC32
+ * 每发出一块就把这块原始数据交给它，连续的数据每攒够 INCREMENTAL_CRC_PIECE 字节提交一片到 ThreadPool，各片独立计算，互不等待
+ * 已完成的片按顺序用 crc32Combine 合并，最后一块发出时前面的片基本都已算完；CANoe 线程用 tryDigest 取结果，不等待
+ * 每片任务持有数据所有者的引用(reset 时传入)和本轮计算的取消标记；reset 不等待：置位取消标记并丢下未完成的片，
+ * 还没开始的片直接返回，正在计算的片结果被丢弃
+ * */
+class IncrementalCrc {
+private:
+    typedef struct CrcPiece {
+        std::future<uint32_t> crc;
+        uint64_t length;
+    } CrcPiece;
+
+    std::deque<CrcPiece> pieces;
+    std::shared_ptr<const void> owner;             // 数据的所有者，每片任务各持有一份
+    std::shared_ptr<std::atomic<bool>> cancelled;  // 本轮计算的取消标记，每片任务各持有一份
+//    尚未提交的连续数据
+    const uint8_t *pendingData = nullptr;
+    uint64_t pendingLength = 0;
+//    已合并部分的 CRC
+    uint32_t crc = 0;
+
+//    按 INCREMENTAL_CRC_PIECE 切片提交攒下的数据，all 为 true 时不足一片的剩余部分也提交
+    void flush(bool all);
+
+//    合并已完成的片，wait 为 true 时等待全部完成
+    void fold(bool wait);
+
+public:
+    IncrementalCrc() = default;
+
+    IncrementalCrc(const IncrementalCrc &incrementalCrc) = delete;
+
+    IncrementalCrc &operator=(const IncrementalCrc &incrementalCrc) = delete;
+
+//    追加一段数据，与上一段不连续时先提交上一段
+    void update(const uint8_t *data, uint64_t dataLength);
+
+//    全部数据的 CRC32，等待未完成的片
+    uint32_t digest();
+
+//    全部片都已算完时写入 digest 并返回 true，否则立即返回 false
+    bool tryDigest(uint32_t *digest);
+
+//    放弃未完成的片并清空，不等待；sourceOwner 为之后 update 的数据的所有者，片任务持有它
+    void reset(std::shared_ptr<const void> sourceOwner = nullptr);
+
+    ~IncrementalCrc() {
+        reset();
+    }
+};
+
+
+#endif //DLLTEST_INCREMENTALCRC_H
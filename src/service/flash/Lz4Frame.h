@@ -0,0 +1,172 @@
+﻿#ifndef DLLTEST_LZ4FRAME_H
+#define DLLTEST_LZ4FRAME_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// LZ4 帧格式：独立块、不带内容校验，块最大 64KB，ECU 端用标准 LZ4 解码即可
+#define LZ4_FRAME_MAGIC 0x184D2204u
+#define LZ4_BLOCK_MAX_SIZE 65536u
+// 块大小字段最高位为1表示块以原始数据存放
+#define LZ4_BLOCK_UNCOMPRESSED 0x80000000u
+#define LZ4_MIN_MATCH 4
+// 最后 5 字节必须是字面量，最后一个匹配必须在结尾 12 字节之前开始
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_LIMIT 12
+#define LZ4_HASH_BITS 12
+
+static void lz4WriteLE32(uint32_t value, uint8_t *target) {
+    target[0] = static_cast<uint8_t>(value);
+    target[1] = static_cast<uint8_t>(value >> 8);
+    target[2] = static_cast<uint8_t>(value >> 16);
+    target[3] = static_cast<uint8_t>(value >> 24);
+}
+
+static uint32_t lz4Read32(const uint8_t *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// 帧描述符的头校验字节用到的 xxHash32，输入只有两个字节
+static uint32_t xxh32(const uint8_t *data, uint32_t length, uint32_t seed) {
+    const uint32_t prime1 = 2654435761u, prime2 = 2246822519u, prime3 = 3266489917u, prime4 = 668265263u,
+            prime5 = 374761393u;
+    auto rotate = [](uint32_t value, int bits) { return value << bits | value >> (32 - bits); };
+    uint32_t i = 0;
+    uint32_t hash;
+    if (length >= 16) {
+        uint32_t v[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+        for (; i + 16 <= length; i += 16) {
+            for (int lane = 0; lane < 4; ++lane) {
+                v[lane] = rotate(v[lane] + lz4Read32(data + i + lane * 4) * prime2, 13) * prime1;
+            }
+        }
+        hash = rotate(v[0], 1) + rotate(v[1], 7) + rotate(v[2], 12) + rotate(v[3], 18);
+    } else {
+        hash = seed + prime5;
+    }
+    hash += length;
+    for (; i + 4 <= length; i += 4) {
+        hash = rotate(hash + lz4Read32(data + i) * prime3, 17) * prime4;
+    }
+    for (; i < length; ++i) {
+        hash = rotate(hash + data[i] * prime5, 11) * prime1;
+    }
+    hash ^= hash >> 15;
+    hash *= prime2;
+    hash ^= hash >> 13;
+    hash *= prime3;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// 帧头 7 字节：魔数、FLG(版本01、块独立)、BD(块最大64KB)、头校验
+static void lz4FrameHeader(std::vector<uint8_t> *output) {
+    uint8_t header[7];
+    lz4WriteLE32(LZ4_FRAME_MAGIC, header);
+    header[4] = 0x60;
+    header[5] = 0x40;
+    header[6] = static_cast<uint8_t>(xxh32(header + 4, 2, 0) >> 8);
+    output->insert(output->end(), header, header + sizeof(header));
+}
+
+// 帧结束标记，块大小为0
+static void lz4FrameEnd(std::vector<uint8_t> *output) {
+    output->insert(output->end(), 4, 0);
+}
+
+static void lz4WriteLength(uint32_t length, uint8_t *&target) {
+    for (; length >= 255; length -= 255) {
+        *target++ = 255;
+    }
+    *target++ = static_cast<uint8_t>(length);
+}
+
+// 压缩一个不超过 64KB 的块，target 至少要有 lz4BlockBound(length) 字节，返回压缩后长度
+// 贪心匹配，4K 项哈希表，连续找不到匹配时加大步长，以速度为主
+static uint32_t lz4CompressBlock(const uint8_t *data, uint32_t length, uint8_t *target) {
+    uint16_t table[1 << LZ4_HASH_BITS] = {};
+    auto hash = [](uint32_t sequence) { return sequence * 2654435761u >> (32 - LZ4_HASH_BITS); };
+    uint8_t *output = target;
+    uint32_t anchor = 0;
+    if (length > LZ4_MATCH_LIMIT) {
+        uint32_t limit = length - LZ4_MATCH_LIMIT;
+        uint32_t matchEnd = length - LZ4_LAST_LITERALS;
+        uint32_t position = 1;
+        uint32_t misses = 0;
+        while (position < limit) {
+            uint32_t sequence = lz4Read32(data + position);
+            uint32_t slot = hash(sequence);
+            uint32_t candidate = table[slot];
+            table[slot] = static_cast<uint16_t>(position);
+            if (candidate >= position || lz4Read32(data + candidate) != sequence) {
+                position += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            while (position > anchor && candidate > 0 && data[position - 1] == data[candidate - 1]) {
+                position--;
+                candidate--;
+            }
+            uint32_t matchLength = LZ4_MIN_MATCH;
+            while (position + matchLength < matchEnd && data[position + matchLength] == data[candidate + matchLength]) {
+                matchLength++;
+            }
+//            token 高4位为字面量长度，低4位为匹配长度-4，超过 15 的部分以 255 累加的方式追加
+            uint32_t literalLength = position - anchor;
+            uint32_t extraLength = matchLength - LZ4_MIN_MATCH;
+            uint8_t *token = output++;
+            *token = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4
+                                          | (extraLength < 15 ? extraLength : 15));
+            if (literalLength >= 15) {
+                lz4WriteLength(literalLength - 15, output);
+            }
+            memcpy(output, data + anchor, literalLength);
+            output += literalLength;
+            uint32_t distance = position - candidate;
+            *output++ = static_cast<uint8_t>(distance);
+            *output++ = static_cast<uint8_t>(distance >> 8);
+            if (extraLength >= 15) {
+                lz4WriteLength(extraLength - 15, output);
+            }
+            position += matchLength;
+            anchor = position;
+            if (position < limit) {
+                table[hash(lz4Read32(data + position - 2))] = static_cast<uint16_t>(position - 2);
+            }
+        }
+    }
+//    剩余部分全部作为字面量
+    uint32_t literalLength = length - anchor;
+    *output++ = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+    if (literalLength >= 15) {
+        lz4WriteLength(literalLength - 15, output);
+    }
+    memcpy(output, data + anchor, literalLength);
+    output += literalLength;
+    return static_cast<uint32_t>(output - target);
+}
+
+// 块压缩后的最大长度
+static constexpr uint32_t lz4BlockBound(uint32_t length) {
+    return length + length / 255 + 16;
+}
+
+// 把 [data, data + length) 作为一个帧块追加到 output：4字节块大小 + 数据，压缩后不变小时存放原始数据
+static void lz4AppendBlock(const uint8_t *data, uint32_t length, std::vector<uint8_t> *output) {
+    size_t start = output->size();
+    output->resize(start + 4 + lz4BlockBound(length));
+    uint32_t compressedLength = lz4CompressBlock(data, length, output->data() + start + 4);
+    if (compressedLength >= length) {
+        lz4WriteLE32(length | LZ4_BLOCK_UNCOMPRESSED, output->data() + start);
+        memcpy(output->data() + start + 4, data, length);
+        compressedLength = length;
+    } else {
+        lz4WriteLE32(compressedLength, output->data() + start);
+    }
+    output->resize(start + 4 + compressedLength);
+}
+
+#endif //DLLTEST_LZ4FRAME_H
@@ -0,0 +1,56 @@
+﻿#ifndef DLLTEST_MAPPEDFILE_H
+#define DLLTEST_MAPPEDFILE_H
+
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/*
+ * MappedFile  只读内存映射文件
+ * 刷写镜像整体映射到进程地址空间，由系统按页调入，TransferData 直接引用映射中的数据，不再读入中间缓冲区
+ * */
+class MappedFile {
+private:
+    const uint8_t *view = nullptr;
+    uint64_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+public:
+    MappedFile() = default;
+
+//    禁止拷贝构造
+    MappedFile(const MappedFile &mappedFile) = delete;
+
+    MappedFile &operator=(const MappedFile &mappedFile) = delete;
+
+//    打开并映射整个文件，空文件或打开失败返回 false
+    bool open(const char *path);
+
+    void close();
+
+    [[nodiscard]] const uint8_t *data() const {
+        return view;
+    }
+
+    [[nodiscard]] uint64_t size() const {
+        return length;
+    }
+
+    [[nodiscard]] bool isOpen() const {
+        return view != nullptr;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+};
+
+
+#endif //DLLTEST_MAPPEDFILE_H
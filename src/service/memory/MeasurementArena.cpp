@@ -0,0 +1,44 @@
+﻿#include "MeasurementArena.h"
+
+static void printPoolStatistics(const char *name, const ObjectPoolStatistics &statistics) {
+    cclPrintf("MeasurementArena %s live=%u peak=%u created=%llu chunks=%u", name, statistics.live,
+              statistics.peak, statistics.created, statistics.chunks);
+}
+
+void MeasurementArena::release() {
+    printStatistics();
+//    发送器析构时取消定时任务、退出总线调度和事件分发，必须在节点释放前析构
+    DiagTransmitter::pool().clear();
+//    发送器引用了镜像映射中的数据，之后再关闭映射
+    FlashDownload::pool().clear();
+//    节点和 DiagConfig 跨测量保留，CAPL 的配置和按 ID 注册在下一次测量仍然有效；只清掉运行期对象的引用
+    for (auto &entry: nodeMap) {
+        Node *node = entry.second;
+        node->diagReceiver = nullptr;
+        node->udsClient = nullptr;
+        node->flashDownload = nullptr;
+        node->activeSessionId = 0;
+        node->lastActivityTime = 0;
+    }
+    DiagReceiver::pool().clear();
+    UdsClient::pool().clear();
+    {
+        std::lock_guard<std::mutex> lock(DiagCompletion::getInstance()->sessionMutex());
+        SessionTable::getInstance()->clear();
+    }
+    PayloadPool::getInstance()->clear();
+}
+
+void MeasurementArena::printStatistics() {
+    printPoolStatistics("Node", NodeService::nodePool().getStatistics());
+    printPoolStatistics("DiagConfig", NodeService::diagConfigPool().getStatistics());
+    printPoolStatistics("DiagReceiver", DiagReceiver::pool().getStatistics());
+    printPoolStatistics("DiagTransmitter", DiagTransmitter::pool().getStatistics());
+    printPoolStatistics("UdsClient", UdsClient::pool().getStatistics());
+    printPoolStatistics("FlashDownload", FlashDownload::pool().getStatistics());
+    cclPrintf("MeasurementArena DiagSession live=%u capacity=%u", SessionTable::getInstance()->size(),
+              SESSION_TABLE_SIZE);
+    const PayloadPoolStatistics &payload = PayloadPool::getInstance()->getStatistics();
+    cclPrintf("MeasurementArena Payload heapAllocations=%llu reused=%llu cachedBytes=%llu",
+              payload.heapAllocations, payload.reused, payload.cachedBytes);
+}
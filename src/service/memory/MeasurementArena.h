@@ -0,0 +1,20 @@
+﻿#ifndef DLLTEST_MEASUREMENTARENA_H
+#define DLLTEST_MEASUREMENTARENA_H
+
+/*
+ * MeasurementArena  测量期间诊断对象的统一释放
+ * DiagReceiver、DiagTransmitter、UdsClient、FlashDownload 都从各自的对象池分配，诊断会话由 SessionTable 的固定槽位承载，
+ * 超过内联长度的请求数据来自 PayloadPool，测量结束时按依赖顺序一次性析构并归还全部存储，同一个 CANoe 进程中反复测量不再增长
+ * Node 和 DiagConfig 是 CAPL 的配置，跨测量保留，不在这里释放
+ * */
+class MeasurementArena {
+public:
+//    OnMeasurementStop 调用，打印各对象池的存活计数后释放全部运行期对象
+    static void release();
+
+//    打印各对象池的存活计数
+    static void printStatistics();
+};
+
+
+#endif //DLLTEST_MEASUREMENTARENA_H
@@ -6,13 +6,25 @@
 
 
 int8_t NodeService::createNode(uint16_t nmId) {
+//    节点跨测量保留，已存在时视为创建成功，CAPL 在每次测量的 on start 中都可以调用
     if (nodeMap.find(nmId) != nodeMap.end()) {
-        return 0;
+        return 1;
     }
-    Node *node = new Node();
+    Node *node = nodePool().create();
+    node->diagConfig = diagConfigPool().create();
     node->NodeHandle = nmId;
     node->BaseId = nmId & 0xFF00;
     node->EcuId = nmId & 0x00FF;
     nodeMap.insert(std::pair<uint16_t, Node *>(nmId, node));
     return 1;
 }
+
+ObjectPool<Node> &NodeService::nodePool() {
+    static ObjectPool<Node> pool;
+    return pool;
+}
+
+ObjectPool<DiagConfig> &NodeService::diagConfigPool() {
+    static ObjectPool<DiagConfig> pool;
+    return pool;
+}
@@ -5,6 +5,8 @@
 #ifndef DLLTEST_NODESERVICE_H
 #define DLLTEST_NODESERVICE_H
 
+#include "../../model/vo/ObjectPool.h"
+
 //全局变量用于存储节点
 static std::map<uint16_t, Node *> nodeMap = std::map<uint16_t, Node *>();
 
@@ -12,6 +14,10 @@ class NodeService {
 private:
 public:
     static int8_t createNode(uint16_t nmId);
+
+    static ObjectPool<Node> &nodePool();
+
+    static ObjectPool<DiagConfig> &diagConfigPool();
 };
 
 
@@ -0,0 +1,240 @@
+﻿#include <bit>
+#include "TimerScheduler.h"
+
+long long TimerScheduler::now() {
+    VIATime time = 0;
+    if (gVIAService != nullptr && gVIAService->GetCurrentSimTime(&time) == kVIA_OK) {
+        globalVar.runTime = time;
+    }
+    return globalVar.runTime;
+}
+
+void TimerScheduler::init(int id) {
+    clear();
+    timerID = id;
+}
+
+void TimerScheduler::link(TimerTask *task, int level, uint8_t slot) {
+    TimerTask *&head = slots[level][slot];
+    task->prev = nullptr;
+    task->next = head;
+    if (head != nullptr) {
+        head->prev = task;
+    }
+    head = task;
+    task->level = static_cast<int8_t>(level);
+    task->slot = slot;
+    if (level < LEVELS) {
+        occupied[level][slot >> 6] |= 1ULL << (slot & 63);
+    }
+    count++;
+}
+
+void TimerScheduler::unlink(TimerTask *task) {
+    TimerTask *&head = slots[task->level][task->slot];
+    if (task->prev != nullptr) {
+        task->prev->next = task->next;
+    } else {
+        head = task->next;
+    }
+    if (task->next != nullptr) {
+        task->next->prev = task->prev;
+    }
+    if (head == nullptr && task->level < LEVELS) {
+        occupied[task->level][task->slot >> 6] &= ~(1ULL << (task->slot & 63));
+    }
+    task->prev = nullptr;
+    task->next = nullptr;
+    task->level = -1;
+    count--;
+}
+
+void TimerScheduler::place(TimerTask *task) {
+    uint64_t delta = task->expires - currentTick;
+    for (int level = 0; level < LEVELS; ++level) {
+        int shift = SLOT_BITS * (level + 1);
+        if (delta < (1ULL << shift) || level == LEVELS - 1) {
+            if (level == LEVELS - 1 && delta >= (1ULL << shift)) {
+//                超出时间轮范围(约127天)，按最大范围处理
+                task->expires = currentTick + (1ULL << shift) - 1;
+            }
+            link(task, level, static_cast<uint8_t>((task->expires >> (SLOT_BITS * level)) & (SLOTS - 1)));
+            return;
+        }
+    }
+}
+
+void TimerScheduler::cascade(int level, uint8_t slot) {
+    TimerTask *task = slots[level][slot];
+    slots[level][slot] = nullptr;
+    occupied[level][slot >> 6] &= ~(1ULL << (slot & 63));
+    while (task != nullptr) {
+        TimerTask *next = task->next;
+        task->level = -1;
+        count--;
+        place(task);
+        task = next;
+    }
+}
+
+int TimerScheduler::findOccupied(int level, int index) const {
+    for (int word = index >> 6; word < SLOTS / 64; ++word) {
+        uint64_t bits = occupied[level][word];
+        if (word == index >> 6) {
+            bits &= ~0ULL << (index & 63);
+        }
+        if (bits != 0) {
+            return (word << 6) + std::countr_zero(bits);
+        }
+    }
+    return -1;
+}
+
+bool TimerScheduler::nextTick(uint64_t *tick) const {
+    bool found = false;
+    uint64_t best = 0;
+    for (int level = 0; level < LEVELS; ++level) {
+        int shift = SLOT_BITS * level;
+        uint64_t blockSize = 1ULL << (shift + SLOT_BITS);
+        uint64_t blockBase = currentTick & ~(blockSize - 1);
+        int index = static_cast<int>((currentTick >> shift) & (SLOTS - 1));
+//        第0层的当前槽位尚未处理；更高层的当前槽位只有在刚好对齐时才尚未降层
+        bool aligned = (currentTick & ((1ULL << shift) - 1)) == 0;
+        int start = aligned ? index : index + 1;
+        uint64_t candidate;
+        int slot = start < SLOTS ? findOccupied(level, start) : -1;
+        if (slot >= 0) {
+            candidate = blockBase | (static_cast<uint64_t>(slot) << shift);
+        } else {
+            slot = findOccupied(level, 0);
+            if (slot < 0 || slot >= start) {
+                continue;
+            }
+            candidate = (blockBase + blockSize) | (static_cast<uint64_t>(slot) << shift);
+        }
+        if (!found || candidate < best) {
+            best = candidate;
+            found = true;
+        }
+    }
+    *tick = best;
+    return found;
+}
+
+void TimerScheduler::processTick() {
+    uint64_t tick = currentTick;
+    auto index = static_cast<uint8_t>(tick & (SLOTS - 1));
+//    第0层转完一圈时，把上一层对应槽位的任务降下来
+    if (index == 0) {
+        for (int level = 1; level < LEVELS; ++level) {
+            auto slot = static_cast<uint8_t>((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+            cascade(level, slot);
+            if (slot != 0) {
+                break;
+            }
+        }
+    }
+    while (slots[0][index] != nullptr) {
+        TimerTask *task = slots[0][index];
+        unlink(task);
+        link(task, EXPIRED, 0);
+    }
+//    先推进刻度再回调，回调中新挂起的已到期任务会落到下一刻度
+    currentTick = tick + 1;
+    while (slots[EXPIRED][0] != nullptr) {
+        TimerTask *task = slots[EXPIRED][0];
+        unlink(task);
+        TimerEvent timerEvent = {dispatchTime, task->timerType};
+        if (task->listener->onEvent(TimeEvent, &timerEvent)) {
+            task->listener->run();
+        }
+    }
+}
+
+void TimerScheduler::schedule(TimerTask *task, long long deadline) {
+    if (task->pending()) {
+        unlink(task);
+    }
+//    时间轮空闲期间没有推进，重新启用时先对齐到当前时间
+    if (count == 0 && !dispatching && timerID >= 0) {
+        auto nowTick = static_cast<uint64_t>(now() / TICK);
+        currentTick = nowTick > currentTick ? nowTick : currentTick;
+    }
+    task->deadline = deadline;
+    uint64_t expires = deadline <= 0 ? 0 : static_cast<uint64_t>((deadline + TICK - 1) / TICK);
+    task->expires = expires < currentTick ? currentTick : expires;
+    place(task);
+    if (timerID >= 0 && (armedTime < 0 || static_cast<long long>(task->expires) * TICK < armedTime)) {
+        arm(now());
+    }
+}
+
+void TimerScheduler::cancel(TimerTask *task) {
+    if (!task->pending()) {
+        return;
+    }
+    unlink(task);
+//    最后一个任务取消后让定时器空闲
+    if (count == 0 && timerID >= 0) {
+        arm(now());
+    }
+}
+
+void TimerScheduler::advance(long long time) {
+    auto target = static_cast<uint64_t>(time / TICK);
+    bool nested = dispatching;
+    dispatching = true;
+    dispatchTime = time;
+    uint64_t tick;
+    while (nextTick(&tick) && tick <= target) {
+        currentTick = tick;
+        processTick();
+    }
+    if (currentTick <= target) {
+        currentTick = target + 1;
+    }
+    dispatching = nested;
+}
+
+void TimerScheduler::onTimer(long long time) {
+    globalVar.runTime = time;
+    armedTime = -1;
+    advance(time);
+    arm(time);
+}
+
+void TimerScheduler::arm(long long time) {
+    if (dispatching || timerID < 0) {
+        return;
+    }
+    uint64_t tick;
+    if (!nextTick(&tick)) {
+        if (armedTime >= 0) {
+            cclTimerCancel(timerID);
+            armedTime = -1;
+        }
+        return;
+    }
+    long long at = static_cast<long long>(tick) * TICK;
+    if (at == armedTime) {
+        return;
+    }
+    long long delay = at - time;
+//    cclTimerSet 只接受正的相对时间
+    if (cclTimerSet(timerID, delay > 0 ? delay : 1) == CCL_SUCCESS) {
+        armedTime = at;
+    }
+}
+
+void TimerScheduler::clear() {
+    for (auto &level: slots) {
+        for (auto &head: level) {
+            while (head != nullptr) {
+                unlink(head);
+            }
+        }
+    }
+    count = 0;
+    currentTick = 0;
+    armedTime = -1;
+}
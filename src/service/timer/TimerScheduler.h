@@ -0,0 +1,125 @@
+﻿#ifndef DLLTEST_TIMERSCHEDULER_H
+#define DLLTEST_TIMERSCHEDULER_H
+
+#include "../event/EventListener.h"
+
+// 定时器类型，回调时用于区分同一个监听器上的多个定时器
+enum TimerType {
+    NAsTimer,       // 等待发送确认
+    NBsTimer,       // 等待流控帧
+    NCsTimer,       // 发送下一个连续帧
+    NCrTimer,       // 等待下一个连续帧
+    STminTimer,     // 连续帧间隔
+    P2Timer,        // 等待响应，P2/P2*
+    S3Timer,        // 会话保持
+    FlashTimer,     // 刷写等待后台压缩或 CRC 完成后重试
+};
+
+// TimeEvent 携带的事件内容
+typedef struct TimerEvent {
+    long long time;       // 触发时间，纳秒
+    TimerType timerType;
+} TimerEvent;
+
+/*
+ * TimerTask  定时任务，内嵌在使用者对象中，调度器只串链表指针，不单独申请内存
+ * */
+typedef struct TimerTask {
+    EventListener *listener = nullptr;
+    TimerType timerType = NAsTimer;
+    long long deadline = 0;         // 到期的绝对时间，纳秒
+    uint64_t expires = 0;           // 到期的时间轮刻度
+    int8_t level = -1;              // 所在层，-1 表示未挂起
+    uint8_t slot = 0;               // 所在槽位
+    TimerTask *prev = nullptr;
+    TimerTask *next = nullptr;
+
+    [[nodiscard]] bool pending() const {
+        return level >= 0;
+    }
+} TimerTask;
+
+/*
+ * TimerScheduler  分层时间轮
+ * 所有 ISO-TP 和 UDS 定时器(N_As/N_Bs/N_Cs/N_Cr、P2/P2*、S3)共用一个时间轮，
+ * 挂起和取消都是 O(1) 的链表操作，推进时只处理有任务的槽位，不随定时器数量增长；
+ * CANoe 定时器只装定到下一个需要处理的刻度，没有挂起的任务时定时器空闲
+ * */
+class TimerScheduler {
+public:
+//    时间轮刻度，10us
+    static constexpr long long TICK = 10000;
+    static constexpr int LEVELS = 5;
+    static constexpr int SLOT_BITS = 8;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+//    到期待分发的任务放在 EXPIRED 层，回调中取消它们时同样是 O(1)
+    static constexpr int EXPIRED = LEVELS;
+
+private:
+    TimerTask *slots[LEVELS + 1][SLOTS] = {};
+//    每层槽位占用位图，用于跳过空槽位
+    uint64_t occupied[LEVELS][SLOTS / 64] = {};
+    uint64_t currentTick = 0;       // 下一个待处理的刻度，之前的刻度都已处理
+    size_t count = 0;
+    int timerID = -1;
+    long long armedTime = -1;       // 当前 CANoe 定时器对应的绝对时间，-1 表示未装定
+    bool dispatching = false;       // 正在分发到期任务，结束后统一重新装定
+    long long dispatchTime = 0;     // 本次分发对应的仿真时间
+
+    void link(TimerTask *task, int level, uint8_t slot);
+
+    void unlink(TimerTask *task);
+
+//    按到期刻度放入对应层的槽位
+    void place(TimerTask *task);
+
+//    把某层槽位中的任务重新放到更低的层
+    void cascade(int level, uint8_t slot);
+
+//    从 index 开始查找第一个被占用的槽位，找不到返回 -1
+    int findOccupied(int level, int index) const;
+
+//    下一个需要处理的刻度（到期或需要降层），没有任务返回 false
+    bool nextTick(uint64_t *tick) const;
+
+//    处理 currentTick 这一刻度
+    void processTick();
+
+//    按下一个需要处理的刻度装定 CANoe 定时器
+    void arm(long long time);
+
+public:
+    static TimerScheduler *getInstance() {
+        static TimerScheduler *instance = nullptr;
+        if (instance == nullptr) {
+            instance = new TimerScheduler();
+        }
+        return instance;
+    }
+
+//    当前仿真时间，纳秒
+    static long long now();
+
+    void init(int timerID);
+
+//    挂起或重新挂起任务，deadline 为绝对时间
+    void schedule(TimerTask *task, long long deadline);
+
+    void cancel(TimerTask *task);
+
+//    推进时间轮并分发所有到期任务，不装定 CANoe 定时器
+    void advance(long long time);
+
+//    CANoe 定时器回调，分发所有到期任务后重新装定
+    void onTimer(long long time);
+
+//    测量结束时清空所有任务
+    void clear();
+
+    [[nodiscard]] size_t size() const {
+        return count;
+    }
+};
+
+
+#endif //DLLTEST_TIMERSCHEDULER_H
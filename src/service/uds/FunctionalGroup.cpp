@@ -0,0 +1,94 @@
+﻿#include "FunctionalGroup.h"
+
+void FunctionalGroup::onRequestSent(DiagSession *request, long long time) {
+    SessionTable *sessionTable = SessionTable::getInstance();
+    for (uint32_t memberId: request->members) {
+        DiagSession *member = sessionTable->find(memberId);
+        if (member == nullptr || member->isFinished() || nodeMap.find(member->nodeHandle) == nodeMap.end()) {
+            continue;
+        }
+        member->diagSessionState = sendComplete;
+        nodeMap[member->nodeHandle]->udsClient->onRequestSent(member, time);
+    }
+}
+
+void FunctionalGroup::onFinished(DiagSession *session) {
+    SessionTable *sessionTable = SessionTable::getInstance();
+//    功能请求发送失败，成员不会再收到响应
+    if (!session->members.empty() && session->diagSessionState == failed) {
+        for (uint32_t memberId: session->members) {
+            DiagSession *member = sessionTable->find(memberId);
+            if (member != nullptr && !member->isFinished()) {
+                member->groupId = 0;
+                member->setErrorStatus(static_cast<ErrorStatus>(session->errorStatus));
+                member->diagSessionState = failed;
+                DiagCompletion::getInstance()->notify(member);
+            }
+        }
+        return;
+    }
+    if (session->groupId == 0) {
+        return;
+    }
+    DiagSession *request = sessionTable->find(session->groupId);
+    if (request == nullptr || request->isFinished()) {
+        return;
+    }
+    long long responseTime = 0;
+    for (uint32_t memberId: request->members) {
+        DiagSession *member = sessionTable->find(memberId);
+        if (member != nullptr && !member->isFinished()) {
+            return;
+        }
+        if (member != nullptr && member->responseTime > responseTime) {
+            responseTime = member->responseTime;
+        }
+    }
+//    成员的异常汇总到功能请求上，没有任何成员应答时整组失败
+    for (uint32_t memberId: request->members) {
+        DiagSession *member = sessionTable->find(memberId);
+        if (member != nullptr) {
+            request->errorStatus |= member->errorStatus;
+        }
+    }
+    request->responseTime = responseTime;
+    request->diagSessionState = getAnsweredCount(request->id) > 0 ? received : failed;
+    DiagCompletion::getInstance()->notify(request);
+}
+
+int32_t FunctionalGroup::getResultCount(uint32_t diagId) {
+    DiagSession *request = SessionTable::getInstance()->find(diagId);
+    if (request == nullptr || request->addressingMode != functional) {
+        return -1;
+    }
+    return static_cast<int32_t>(request->members.size());
+}
+
+int32_t FunctionalGroup::getAnsweredCount(uint32_t diagId) {
+    SessionTable *sessionTable = SessionTable::getInstance();
+    DiagSession *request = sessionTable->find(diagId);
+    if (request == nullptr || request->addressingMode != functional) {
+        return -1;
+    }
+    int32_t answered = 0;
+    for (uint32_t memberId: request->members) {
+        DiagSession *member = sessionTable->find(memberId);
+        if (member != nullptr && member->diagSessionState == received) {
+            answered++;
+        }
+    }
+    return answered;
+}
+
+uint32_t FunctionalGroup::getResultDiagId(uint32_t diagId, uint32_t index) {
+    DiagSession *request = SessionTable::getInstance()->find(diagId);
+    if (request == nullptr || index >= request->members.size()) {
+        return 0;
+    }
+    return request->members[index];
+}
+
+int32_t FunctionalGroup::getResultNode(uint32_t diagId, uint32_t index) {
+    DiagSession *member = SessionTable::getInstance()->find(getResultDiagId(diagId, index));
+    return member == nullptr ? -1 : member->nodeHandle;
+}
@@ -0,0 +1,36 @@
+﻿#ifndef DLLTEST_FUNCTIONALGROUP_H
+#define DLLTEST_FUNCTIONALGROUP_H
+
+#include "../../model/vo/DiagV0.h"
+
+/*
+ * FunctionalGroup  功能寻址请求的结果集
+ * 功能请求本身是一个会话，只负责按 FuncAddr 发出单帧；同一 FuncAddr 下的每个节点各有一个成员会话，
+ * 由各自的 DiagReceiver/UdsClient 接收并在 P2 内等待响应，成员全部结束后功能请求结束：
+ * 至少一个成员接收完成时为接收完成，全部超时或失败时为失败，错误位是各成员错误位的并集
+ * 会话表分配不到全部成员会话时请求不发出，Diag_SendByFunctional 返回0
+ * 成员会话的诊断ID可直接用于 Diag_GetResponse、Diag_GetErrorStatus、Diag_GetLatency
+ * */
+class FunctionalGroup {
+public:
+//    功能请求的单帧已确认发送，所有成员从确认时间 time 开始 P2 计时
+    static void onRequestSent(DiagSession *request, long long time);
+
+//    会话进入终态，由 DiagCompletion::notify 调用：成员结束时检查整组，功能请求失败时结束尚未开始的成员
+    static void onFinished(DiagSession *session);
+
+//    结果集中的成员数，诊断不存在或不是功能请求时返回-1
+    static int32_t getResultCount(uint32_t diagId);
+
+//    结果集中接收完成的成员数(SPRMIB 下静默成功的也计入)，诊断不存在或不是功能请求时返回-1
+    static int32_t getAnsweredCount(uint32_t diagId);
+
+//    第 index 个成员会话的诊断ID，不存在时返回0
+    static uint32_t getResultDiagId(uint32_t diagId, uint32_t index);
+
+//    第 index 个成员所属的节点，不存在时返回-1
+    static int32_t getResultNode(uint32_t diagId, uint32_t index);
+};
+
+
+#endif //DLLTEST_FUNCTIONALGROUP_H
@@ -0,0 +1,153 @@
+﻿#include "TesterPresent.h"
+
+// TesterPresent，子功能 0x00 带 SPRMIB，ECU 不回正响应
+static const uint8_t TESTER_PRESENT_REQUEST[] = {0x3E, UDS_SPRMIB};
+// 驱动拒绝发送后的重试间隔
+static const long long TESTER_PRESENT_RETRY_DELAY = 10000000LL;
+// 保持帧相对 S3Server 的提前量，单位ms，S3Server 不足两倍余量时取其一半
+static const uint16_t TESTER_PRESENT_MARGIN = 1000;
+
+long long TesterPresent::period(const Node *node) {
+    const SessionLayerTime &sessionLayerTime = node->diagConfig->sessionLayerTime;
+    uint16_t S3Server = sessionLayerTime.S3Server;
+    uint16_t serverLimit = S3Server > 2 * TESTER_PRESENT_MARGIN ? S3Server - TESTER_PRESENT_MARGIN : S3Server / 2;
+    uint16_t interval = sessionLayerTime.S3Client < serverLimit ? sessionLayerTime.S3Client : serverLimit;
+    return cclTimeMilliseconds(interval);
+}
+
+bool TesterPresent::functionalBusy(uint16_t funcAddr) {
+    for (auto &entry: nodeMap) {
+        if (entry.second->diagConfig->FuncAddr == funcAddr && busy(entry.second)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TesterPresent::busy(const Node *node) {
+    DiagSession *session = SessionTable::getInstance()->find(node->activeSessionId);
+    return session != nullptr && !session->isFinished();
+}
+
+bool TesterPresent::send(Node *node, AddressingMode addressingMode) {
+    if (node->frameEncoder == nullptr) {
+        FrameEncoderFactory::configure(node);
+    }
+    node->frameEncoder->encodeSingleFrame(TESTER_PRESENT_REQUEST, sizeof(TESTER_PRESENT_REQUEST), addressingMode,
+                                          &frame);
+    VIAResult result = globalVar.canBus->OutputMessage3(globalVar.VIAChannel, frame.id, frame.flags, 0  // 重发次数
+            , frame.dataLength, frame.data);
+    if (result != kVIA_OK) {
+        statistics.sendFailed++;
+        return false;
+    }
+    return true;
+}
+
+void TesterPresent::keepAlive() {
+    long long now = TimerScheduler::now();
+    for (Node *node: nodes) {
+        if (node->lastActivityTime + period(node) > now) {
+            continue;
+        }
+//        诊断进行中 ECU 不计 S3，结束时会重新记录 lastActivityTime
+        if (busy(node)) {
+            node->lastActivityTime = now;
+            statistics.skippedBusy++;
+            continue;
+        }
+//        同一 FuncAddr 下半个周期内也将到期的节点一起保持
+        uint16_t funcAddr = node->diagConfig->FuncAddr;
+        uint32_t dueCount = 0;
+        for (Node *peer: nodes) {
+            if (peer->diagConfig->FuncAddr == funcAddr && !busy(peer)
+                && peer->lastActivityTime + period(peer) / 2 <= now) {
+                dueCount++;
+            }
+        }
+//        功能寻址帧会到达 FuncAddr 相同的所有节点，其中有请求未结束时不能插入功能寻址 3E，只按物理地址保持本节点
+        if (dueCount < 2 || functionalBusy(funcAddr)) {
+            if (send(node, physical)) {
+                node->lastActivityTime = now;
+                statistics.physicalFrames++;
+            }
+            continue;
+        }
+        if (!send(node, functional)) {
+            continue;
+        }
+        statistics.functionalFrames++;
+//        功能寻址帧到达 FuncAddr 相同的所有节点
+        for (Node *peer: nodes) {
+            if (peer->diagConfig->FuncAddr == funcAddr) {
+                peer->lastActivityTime = now;
+                statistics.coveredNodes++;
+            }
+        }
+    }
+    reschedule();
+}
+
+void TesterPresent::reschedule() {
+    if (nodes.empty()) {
+        TimerScheduler::getInstance()->cancel(&keepAliveTask);
+        return;
+    }
+    long long deadline = nodes[0]->lastActivityTime + period(nodes[0]);
+    for (Node *node: nodes) {
+        long long due = node->lastActivityTime + period(node);
+        deadline = due < deadline ? due : deadline;
+    }
+    long long now = TimerScheduler::now();
+//    发送失败的节点仍处于到期状态，稍后重试
+    if (deadline <= now) {
+        deadline = now + TESTER_PRESENT_RETRY_DELAY;
+    }
+    TimerScheduler::getInstance()->schedule(&keepAliveTask, deadline);
+}
+
+bool TesterPresent::onEvent(EventType type, void *event) {
+    if (type == TimeEvent && static_cast<TimerEvent *>(event)->timerType == S3Timer) {
+        keepAlive();
+    }
+    return false;
+}
+
+void TesterPresent::run() {
+}
+
+void TesterPresent::reset() {
+    TimerScheduler::getInstance()->cancel(&keepAliveTask);
+}
+
+void TesterPresent::start() {
+    long long now = TimerScheduler::now();
+    for (Node *node: nodes) {
+        node->lastActivityTime = now;
+    }
+    reschedule();
+}
+
+int8_t TesterPresent::configTesterPresent(uint16_t NodeHandle, uint8_t enable) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return 0;
+    }
+    Node *node = nodeMap[NodeHandle];
+    TesterPresent *testerPresent = getInstance();
+    if (enable != 0 && !node->testerPresent) {
+        node->testerPresent = true;
+        testerPresent->nodes.push_back(node);
+    } else if (enable == 0 && node->testerPresent) {
+        node->testerPresent = false;
+        std::erase(testerPresent->nodes, node);
+    }
+    testerPresent->reschedule();
+    return 1;
+}
+
+void TesterPresent::printStatistics() {
+    TesterPresentStatistics &statistics = getInstance()->statistics;
+    cclPrintf("TesterPresent nodes=%d functional=%llu covered=%llu physical=%llu skippedBusy=%llu failed=%llu",
+              static_cast<int>(getInstance()->nodes.size()), statistics.functionalFrames, statistics.coveredNodes,
+              statistics.physicalFrames, statistics.skippedBusy, statistics.sendFailed);
+}
@@ -0,0 +1,83 @@
+﻿#ifndef DLLTEST_TESTERPRESENT_H
+#define DLLTEST_TESTERPRESENT_H
+
+#include <vector>
+#include "../event/EventListener.h"
+#include "../timer/TimerScheduler.h"
+#include "../diag/FrameEncoder.h"
+#include "UdsClient.h"
+#include "../../model/entity/Node.h"
+
+// TesterPresent 统计，用于确认功能寻址合并后总线上的保持帧数
+typedef struct TesterPresentStatistics {
+    uint64_t functionalFrames = 0;  // 发出的功能寻址 3E 80
+    uint64_t physicalFrames = 0;    // 发出的物理寻址 3E 80
+    uint64_t coveredNodes = 0;      // 功能寻址帧一次保持的节点数之和
+    uint64_t skippedBusy = 0;       // 到期时正在诊断、不需要保持的次数
+    uint64_t sendFailed = 0;        // 驱动拒绝发送的次数
+} TesterPresentStatistics;
+
+/*
+ * TesterPresent  非默认会话的保持
+ * 所有需要保持的节点共用一个 S3 定时任务，定时器只装定到最早到期的节点
+ * 节点提交请求或请求结束时记录 lastActivityTime，近期有诊断的节点不发保持帧；到期时正在诊断的节点同样跳过
+ * 到期时 FuncAddr 相同的节点中，半个周期内也将到期的一起用一帧功能寻址 3E 80 保持，只有一个节点、
+ * 或 FuncAddr 相同的节点有请求未结束时按物理地址发送
+ * 保持帧只有一个单帧、不期待响应，不创建会话，也不占用 BusScheduler 的名额
+ * */
+class TesterPresent : public EventListener {
+private:
+    std::vector<Node *> nodes;  // 需要保持会话的节点
+    TimerTask keepAliveTask;
+    cclCanMessage frame = {};
+    TesterPresentStatistics statistics;
+
+//    处理所有到期的节点并重新装定
+    void keepAlive();
+
+//    按最早到期的节点装定定时任务，没有节点时取消
+    void reschedule();
+
+    bool send(Node *node, AddressingMode addressingMode);
+
+//    节点的保持周期，纳秒：S3Client，且至少比 S3Server 提前 TESTER_PRESENT_MARGIN，保证在 ECU 的 S3 到期前到达
+    static long long period(const Node *node);
+
+//    节点当前有未结束的诊断
+    static bool busy(const Node *node);
+
+//    FuncAddr 相同的节点(不只是需要保持的节点)中有未结束的诊断
+    static bool functionalBusy(uint16_t funcAddr);
+
+public:
+    static TesterPresent *getInstance() {
+        static TesterPresent *instance = nullptr;
+        if (instance == nullptr) {
+            instance = new TesterPresent();
+        }
+        return instance;
+    }
+
+    TesterPresent() {
+        keepAliveTask.listener = this;
+        keepAliveTask.timerType = S3Timer;
+    }
+
+    bool onEvent(EventType type, void *event) override;
+
+    void run() override;
+
+//    测量结束，取消定时任务；需要保持的节点跨测量保留
+    void reset();
+
+//    测量开始，从现在起重新计各节点的 S3
+    void start();
+
+//    开启或关闭节点的会话保持，保持周期见 period
+    static int8_t configTesterPresent(uint16_t NodeHandle, uint8_t enable);
+
+    static void printStatistics();
+};
+
+
+#endif //DLLTEST_TESTERPRESENT_H
@@ -0,0 +1,152 @@
+﻿#include "UdsClient.h"
+
+// 子功能字节 bit7 为 SPRMIB 的服务
+static bool supportsSuppressPositiveResponse(uint8_t serviceId) {
+    switch (serviceId) {
+        case 0x10:  // DiagnosticSessionControl
+        case 0x11:  // ECUReset
+        case 0x27:  // SecurityAccess
+        case 0x28:  // CommunicationControl
+        case 0x2C:  // DynamicallyDefineDataIdentifier
+        case 0x31:  // RoutineControl
+        case 0x3E:  // TesterPresent
+        case 0x83:  // AccessTimingParameter
+        case 0x85:  // ControlDTCSetting
+        case 0x86:  // ResponseOnEvent
+        case 0x87:  // LinkControl
+            return true;
+        default:
+            return false;
+    }
+}
+
+UdsClient::UdsClient(Node *node) {
+    this->node = node;
+    responseTimeoutTask.listener = this;
+    responseTimeoutTask.timerType = P2Timer;
+}
+
+void UdsClient::prepare(DiagSession *session) {
+    RequestView request = session->request();
+    session->serviceId = session->dataLength > 0 ? request.at(0) : 0;
+    session->suppressPositiveResponse = session->dataLength > 1
+                                        && supportsSuppressPositiveResponse(session->serviceId)
+                                        && (request.at(1) & UDS_SPRMIB) != 0;
+    session->requestTime = TimerScheduler::now();
+}
+
+void UdsClient::armResponseTimeout(long long time, uint16_t timeoutMs) {
+    TimerScheduler::getInstance()->schedule(&responseTimeoutTask, time + cclTimeMilliseconds(
+            timeoutMs + node->diagConfig->faultToleranceTime));
+}
+
+void UdsClient::onRequestSent(DiagSession *session, long long time) {
+//    响应可能早于最后一帧的发送确认到达，此时会话已结束
+    if (session->isFinished()) {
+        return;
+    }
+    sessionId = session->id;
+//    0x78 先于发送确认到达时已按 P2* 计时，不能再缩回 P2
+    if (session->responsePendingCount > 0) {
+        return;
+    }
+    armResponseTimeout(time, node->diagConfig->sessionLayerTime.P2Client);
+}
+
+void UdsClient::onResponseStart() {
+    TimerScheduler::getInstance()->cancel(&responseTimeoutTask);
+}
+
+void UdsClient::onResponse(DiagSession *session, long long time) {
+    const std::vector<uint8_t> &response = session->responseData;
+    uint8_t serviceId = session->serviceId;
+    if (response.empty()) {
+        return;
+    }
+    if (response[0] == UDS_NEGATIVE_RESPONSE && response.size() >= 3 && response[1] == serviceId) {
+        if (response[2] == UDS_NRC_RESPONSE_PENDING) {
+            session->responsePendingCount++;
+            sessionId = session->id;
+            armResponseTimeout(time, node->diagConfig->sessionLayerTime.P2ClientEx);
+            return;
+        }
+        session->responseTime = time;
+        session->setErrorStatus(NegativeResponse);
+        finish(session, received);
+        return;
+    }
+//    空请求无法匹配，收到什么都交给 CAPL
+    if (serviceId == 0 || response[0] == static_cast<uint8_t>(serviceId + UDS_POSITIVE_RESPONSE_OFFSET)) {
+        session->responseTime = time;
+        finish(session, received);
+        return;
+    }
+    cclPrintf("UdsClient 0x%X 响应 0x%02X 与请求 0x%02X 不匹配，继续等待", node->diagConfig->RespAddr, response[0],
+              serviceId);
+//    不匹配的响应打断了 P2，从现在重新计时；等过 0x78 的继续按 P2*
+    if (session->id == sessionId && session->diagSessionState == sendComplete) {
+        armResponseTimeout(time, session->responsePendingCount > 0 ? node->diagConfig->sessionLayerTime.P2ClientEx
+                                                                   : node->diagConfig->sessionLayerTime.P2Client);
+    }
+}
+
+void UdsClient::finish(DiagSession *session, DiagSessionState state) {
+    TimerScheduler::getInstance()->cancel(&responseTimeoutTask);
+    if (session->id == sessionId) {
+        sessionId = 0;
+    }
+    session->diagSessionState = state;
+//    ECU 发完响应后重新计 S3，TesterPresent 从这里算下一次保持
+    node->lastActivityTime = TimerScheduler::now();
+    DiagCompletion::getInstance()->notify(session);
+}
+
+void UdsClient::responseTimeout() {
+    DiagSession *session = SessionTable::getInstance()->find(sessionId);
+    if (session == nullptr || session->isFinished()) {
+        return;
+    }
+    session->responseTime = TimerScheduler::now();
+//    SPRMIB：服务端不发正响应，P2 内没有否定响应即成功
+    if (session->suppressPositiveResponse && session->responsePendingCount == 0) {
+        session->responseData.clear();
+        finish(session, received);
+        return;
+    }
+    session->setErrorStatus(ResponseTimeout);
+    finish(session, failed);
+    cclPrintf("UdsClient 0x%X 等待响应超时", node->diagConfig->RespAddr);
+}
+
+bool UdsClient::onEvent(EventType type, void *event) {
+    if (type == TimeEvent && static_cast<TimerEvent *>(event)->timerType == P2Timer) {
+        responseTimeout();
+    }
+    return false;
+}
+
+void UdsClient::run() {
+}
+
+ObjectPool<UdsClient> &UdsClient::pool() {
+    static ObjectPool<UdsClient> clientPool;
+    return clientPool;
+}
+
+int8_t UdsClient::configP2(uint16_t NodeHandle, uint16_t P2Client, uint16_t P2ClientEx) {
+    if (nodeMap.find(NodeHandle) == nodeMap.end()) {
+        return 0;
+    }
+    SessionLayerTime &sessionLayerTime = nodeMap[NodeHandle]->diagConfig->sessionLayerTime;
+    sessionLayerTime.P2Client = P2Client;
+    sessionLayerTime.P2ClientEx = P2ClientEx;
+    return 1;
+}
+
+int32_t UdsClient::getLatency(uint32_t diagId) {
+    DiagSession *session = SessionTable::getInstance()->find(diagId);
+    if (session == nullptr || !session->isFinished() || session->responseTime == 0) {
+        return -1;
+    }
+    return static_cast<int32_t>((session->responseTime - session->requestTime) / 1000);
+}
@@ -0,0 +1,74 @@
+﻿#ifndef DLLTEST_UDSCLIENT_H
+#define DLLTEST_UDSCLIENT_H
+
+#include "../event/EventListener.h"
+#include "../timer/TimerScheduler.h"
+#include "../diag/DiagCompletion.h"
+#include "../../model/entity/Node.h"
+#include "../../model/vo/ObjectPool.h"
+
+// 否定响应的服务ID
+#define UDS_NEGATIVE_RESPONSE 0x7F
+// 正响应服务ID = 请求服务ID + 0x40
+#define UDS_POSITIVE_RESPONSE_OFFSET 0x40
+// NRC 0x78 requestCorrectlyReceived-ResponsePending
+#define UDS_NRC_RESPONSE_PENDING 0x78
+// 子功能字节的 suppressPosRspMsgIndicationBit
+#define UDS_SPRMIB 0x80
+
+/*
+ * UdsClient  ISO 14229 客户端，每个节点一个，位于 ISO-TP 收发之上
+ * 请求发送完成后按 P2Client 等待响应开始；收到 NRC 0x78 后按 P2ClientEx(P2*) 继续等待，不需要 CAPL 轮询
+ * 响应按服务ID与请求匹配：正响应为 SID+0x40，否定响应为 7F SID NRC，其他服务ID的响应忽略并继续等待
+ * 请求带 SPRMIB 时不期待正响应，P2 到期即视为成功
+ * 会话记录提交时间和最终响应时间，Diag_GetLatency 读取
+ * */
+class UdsClient : public EventListener {
+private:
+    Node *node;
+    uint32_t sessionId = 0;  // 正在等待响应的诊断ID
+    TimerTask responseTimeoutTask;
+
+//    从 time 起按 timeoutMs(另加容错时间) 重新装定 P2/P2*
+    void armResponseTimeout(long long time, uint16_t timeoutMs);
+
+//    会话进入终态
+    void finish(DiagSession *session, DiagSessionState state);
+
+    void responseTimeout();
+
+public:
+    explicit UdsClient(Node *node);
+
+//    提交请求时调用：记录服务ID、SPRMIB 和提交时间
+    static void prepare(DiagSession *session);
+
+//    请求的最后一帧已确认发送，从确认时间 time 开始 P2 计时；确认前已收到 0x78 的保留 P2*
+    void onRequestSent(DiagSession *session, long long time);
+
+//    收到响应的 SF 或 FF，P2 到此为止，之后由 N_Cr 监控
+    void onResponseStart();
+
+//    响应重组完成，按服务ID匹配并决定会话是否结束
+    void onResponse(DiagSession *session, long long time);
+
+    bool onEvent(EventType type, void *event) override;
+
+    void run() override;
+
+//    本次测量的客户端对象池，测量结束时统一释放
+    static ObjectPool<UdsClient> &pool();
+
+//    配置 P2Client 和 P2ClientEx(P2*)，单位 ms
+    static int8_t configP2(uint16_t NodeHandle, uint16_t P2Client, uint16_t P2ClientEx);
+
+//    请求提交到最终响应的耗时，单位 us；诊断不存在或尚未结束时返回-1
+    static int32_t getLatency(uint32_t diagId);
+
+    ~UdsClient() {
+        TimerScheduler::getInstance()->cancel(&responseTimeoutTask);
+    }
+};
+
+
+#endif //DLLTEST_UDSCLIENT_H
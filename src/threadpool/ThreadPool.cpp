@@ -19,7 +19,26 @@ private:
     std::mutex queue_mutex;
     std::condition_variable condition;
 
-    explicit ThreadPool(int numThreads) : stop(false) {
+    int numThreads;
+
+    explicit ThreadPool(int numThreads) : numThreads(numThreads), stop(true) {
+        start();
+    }
+
+public:
+    static std::shared_ptr<ThreadPool> &getInstance() {
+//        static ThreadPool instance(2);
+        static std::shared_ptr<ThreadPool> instance(new ThreadPool(2));
+        return instance;
+    }
+
+//    启动工作线程，已在运行时不做处理；测量开始时调用，上次测量 shutdown 后重新启动
+    void start() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        if (!stop) {
+            return;
+        }
+        stop = false;
         for (int i = 0; i < numThreads; ++i) {
             workers.emplace_back([this] {
                 for (;;) {
@@ -41,11 +60,25 @@ private:
         }
     }
 
-public:
-    static std::shared_ptr<ThreadPool> &getInstance() {
-//        static ThreadPool instance(2);
-        static std::shared_ptr<ThreadPool> instance(new ThreadPool(2));
-        return instance;
+//    工作线程是否在运行；shutdown 之后到下一次 start 之前提交的任务不会被执行
+    bool running() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        return !stop;
+    }
+
+//    执行完队列中剩余的任务后停止并回收工作线程，可重复调用
+    void shutdown() {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (std::thread &worker: workers) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+        workers.clear();
     }
 
     template<class F, class... Args>
@@ -58,15 +91,18 @@ public:
         condition.notify_one();
     }
 
+//    提交有返回值的任务，通过 future 取结果
+    template<class F>
+    auto submit(F &&f) -> std::future<decltype(f())> {
+        using Result = decltype(f());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        std::future<Result> future = task->get_future();
+        enqueue([task] { (*task)(); });
+        return future;
+    }
+
     ~ThreadPool() {
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            stop = true;
-        }
-        condition.notify_all();
-        for (std::thread &worker: workers) {
-            worker.join();
-        }
+        shutdown();
     }
 
 //    禁止拷贝构造
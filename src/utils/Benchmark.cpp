@@ -0,0 +1,342 @@
+﻿// 性能基准测试，通过 CAPL 调用，结果用 cclPrintf 打印到 Write 窗口
+#pragma once
+
+#include <chrono>
+#include "../service/diag/DiagParsing.h"
+#include "../model/entity/Node.h"
+#include "../service/flash/HexDecoder.h"
+#include "../service/flash/Lz4Frame.h"
+#include "../service/flash/IncrementalCrc.h"
+
+// 统计耗时，单位微秒
+static long long benchElapsedMicros(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// 对 dataLength 字节的请求做完整分帧，验证会话开始后不再逐帧申请堆内存
+static void Debug_BenchFramePool(uint32_t dataLength) {
+    DiagConfig diagConfig;
+    Node node;
+    node.diagConfig = &diagConfig;
+    std::vector<uint8_t> data(dataLength, 0x5A);
+    FramePoolStatistics before = framePoolStatistics;
+    auto *session = new DiagSession();
+    session->data = data.data();
+    session->dataLength = dataLength;
+    auto begin = std::chrono::steady_clock::now();
+    uint32_t frames = 0;
+    while (!session->parsed) {
+        if (ParsingFactory::getInstance()->parse(session, node.diagConfig) == nullptr) {
+            break;
+        }
+        frames++;
+    }
+    long long elapsed = benchElapsedMicros(begin);
+    cclPrintf("Debug_BenchFramePool dataLength=%u frames=%u elapsed=%lldus heapAllocations=%llu framesAcquired=%llu",
+              dataLength, frames, elapsed,
+              framePoolStatistics.heapAllocations - before.heapAllocations,
+              framePoolStatistics.framesAcquired - before.framesAcquired);
+    delete session;
+}
+
+// 对比 ParsingFactory 与节点编码器的分帧吞吐，单位 帧/秒
+static void Debug_BenchFrameEncoder(uint32_t dataLength, uint8_t maxDLC) {
+    const int rounds = 20;
+    DiagConfig diagConfig;
+    Node node;
+    node.diagConfig = &diagConfig;
+    node.diagConfig->maxDLC = maxDLC;
+    FrameEncoderFactory::configure(&node);
+    std::vector<uint8_t> data(dataLength, 0x5A);
+
+    uint64_t legacyFrames = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        DiagSession session;
+        session.data = data.data();
+        session.dataLength = dataLength;
+        while (!session.parsed && ParsingFactory::getInstance()->parse(&session, node.diagConfig) != nullptr) {
+            legacyFrames++;
+        }
+    }
+    long long legacyElapsed = benchElapsedMicros(begin);
+
+    uint64_t encoderFrames = 0;
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        DiagSession session;
+        session.data = data.data();
+        session.dataLength = dataLength;
+        while (node.frameEncoder->encode(&session) != nullptr) {
+            encoderFrames++;
+        }
+    }
+    long long encoderElapsed = benchElapsedMicros(begin);
+
+    cclPrintf("Debug_BenchFrameEncoder maxDLC=%d ParsingFactory: %llu frames %lldus %.0f frames/s",
+              maxDLC, legacyFrames, legacyElapsed, legacyElapsed > 0 ? legacyFrames * 1e6 / legacyElapsed : 0.0);
+    cclPrintf("Debug_BenchFrameEncoder maxDLC=%d FrameEncoder: %llu frames %lldus %.0f frames/s",
+              maxDLC, encoderFrames, encoderElapsed, encoderElapsed > 0 ? encoderFrames * 1e6 / encoderElapsed : 0.0);
+    delete node.frameEncoder;
+}
+
+// 时间轮基准测试用的监听器，到期后按固定间隔重新挂起，保持挂起的定时器数量不变
+class BenchTimerListener : public EventListener {
+public:
+    TimerScheduler *scheduler = nullptr;
+    TimerTask task;
+    long long period = 0;
+    uint64_t fired = 0;
+
+    bool onEvent(EventType, void *event) override {
+        fired++;
+        scheduler->schedule(&task, static_cast<TimerEvent *>(event)->time + period);
+        return false;
+    }
+
+    void run() override {
+    }
+};
+
+// 分别挂起1~10000个定时器，统计每个刻度推进和每次挂起/取消的耗时，单位纳秒
+static void Debug_BenchTimerWheel() {
+    const int steps = 10000;
+    const long long step = cclTimeMicroseconds(100);
+    for (int timers = 1; timers <= 10000; timers *= 10) {
+        auto *scheduler = new TimerScheduler();
+        auto *listeners = new BenchTimerListener[timers];
+        for (int i = 0; i < timers; ++i) {
+            listeners[i].scheduler = scheduler;
+            listeners[i].task.listener = &listeners[i];
+            listeners[i].period = cclTimeMilliseconds(1 + (i * 7919) % 10000);
+            scheduler->schedule(&listeners[i].task, listeners[i].period);
+        }
+        long long time = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < steps; ++i) {
+            time += step;
+            scheduler->advance(time);
+        }
+        long long tickElapsed = benchElapsedMicros(begin);
+        uint64_t fired = 0;
+        for (int i = 0; i < timers; ++i) {
+            fired += listeners[i].fired;
+        }
+        begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < steps; ++i) {
+            BenchTimerListener &listener = listeners[i % timers];
+            scheduler->cancel(&listener.task);
+            scheduler->schedule(&listener.task, time + listener.period);
+        }
+        long long rescheduleElapsed = benchElapsedMicros(begin);
+        cclPrintf("Debug_BenchTimerWheel timers=%d fired=%llu tick=%.1fns cancel+schedule=%.1fns",
+                  timers, fired, tickElapsed * 1000.0 / steps, rescheduleElapsed * 1000.0 / steps);
+        scheduler->clear();
+        delete[] listeners;
+        delete scheduler;
+    }
+}
+
+// 事件分发基准测试用的监听器，只统计收到的报文数
+class BenchCanListener : public EventListener {
+public:
+    uint32_t id = 0;
+    uint64_t received = 0;
+
+    bool onEvent(EventType type, void *event) override {
+        if (type != CanEvent || static_cast<cclCanMessage *>(event)->id != id) {
+            return false;
+        }
+        received++;
+        return false;
+    }
+
+    void run() override {
+    }
+};
+
+// 1000个监听器各自关注一个 CAN ID，对比全部广播与按 ID 索引分发的每帧耗时，单位纳秒
+static void Debug_BenchEventRouting() {
+    const int listenerCount = 1000;
+    const int frames = 100000;
+    auto *listeners = new BenchCanListener[listenerCount];
+    for (int i = 0; i < listenerCount; ++i) {
+        listeners[i].id = 0x100 + i;
+    }
+    cclCanMessage message = {};
+    message.channel = 1;
+
+    auto *broadcast = new EventMulticaster();
+    for (int i = 0; i < listenerCount; ++i) {
+        broadcast->addListener(&listeners[i]);
+    }
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        message.id = 0x100 + (i * 7919) % listenerCount;
+        broadcast->notify(CanEvent, &message);
+    }
+    long long broadcastElapsed = benchElapsedMicros(begin);
+    delete broadcast;
+
+    auto *indexed = new EventMulticaster();
+    for (int i = 0; i < listenerCount; ++i) {
+        indexed->addCanListener(&listeners[i], message.channel, listeners[i].id);
+    }
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        message.id = 0x100 + (i * 7919) % listenerCount;
+        indexed->notify(CanEvent, &message);
+    }
+    long long indexedElapsed = benchElapsedMicros(begin);
+    delete indexed;
+
+    uint64_t received = 0;
+    for (int i = 0; i < listenerCount; ++i) {
+        received += listeners[i].received;
+    }
+    cclPrintf("Debug_BenchEventRouting listeners=%d frames=%d received=%llu broadcast=%.1fns/frame indexed=%.1fns/frame",
+              listenerCount, frames, received, broadcastElapsed * 1000.0 / frames, indexedElapsed * 1000.0 / frames);
+    delete[] listeners;
+}
+
+// 回调线程写入报文旁路的耗时，消费线程与测量时相同，单位纳秒
+static void Debug_BenchFrameCapture(uint32_t frames) {
+    auto *frameCapture = new FrameCapture();
+    frameCapture->start();
+    cclCanMessage message = {};
+    message.id = 0x7BA;
+    message.dataLength = 64;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; ++i) {
+        message.time = i;
+        message.data[0] = static_cast<uint8_t>(i);
+        frameCapture->push(&message);
+    }
+    long long elapsed = benchElapsedMicros(begin);
+    frameCapture->stop();
+    cclPrintf("Debug_BenchFrameCapture frames=%u push=%.1fns/frame", frames, frames > 0 ? elapsed * 1000.0 / frames : 0.0);
+    frameCapture->report(false);
+    delete frameCapture;
+}
+
+// 十六进制数据字段解码吞吐，逐对查表与 8 字符并行解码对比，单位 MB/s(按字符计)
+static void Debug_BenchHexDecode(uint32_t chars) {
+    const int rounds = 20;
+    chars &= ~1u;
+    std::string text(chars, '0');
+    const char digits[] = "0123456789ABCDEF";
+    for (uint32_t i = 0; i < chars; ++i) {
+        text[i] = digits[(i * 7 + (i >> 5)) & 0x0F];
+    }
+    std::vector<uint8_t> pairOutput(chars / 2);
+    std::vector<uint8_t> swarOutput(chars / 2);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (uint32_t i = 0; i < chars; i += 2) {
+            pairOutput[i / 2] = static_cast<uint8_t>(HEX_NIBBLE[static_cast<uint8_t>(text[i])] << 4
+                                                     | HEX_NIBBLE[static_cast<uint8_t>(text[i + 1])]);
+        }
+    }
+    long long pairElapsed = benchElapsedMicros(begin);
+
+    begin = std::chrono::steady_clock::now();
+    bool valid = true;
+    for (int round = 0; round < rounds; ++round) {
+        valid &= decodeHex(text.data(), chars, swarOutput.data());
+    }
+    long long swarElapsed = benchElapsedMicros(begin);
+
+    double megabytes = static_cast<double>(chars) * rounds / 1e6;
+    cclPrintf("Debug_BenchHexDecode chars=%u pair=%.0fMB/s swar=%.0fMB/s valid=%d match=%d", chars,
+              pairElapsed > 0 ? megabytes * 1e6 / pairElapsed : 0.0, swarElapsed > 0 ? megabytes * 1e6 / swarElapsed : 0.0,
+              valid, pairOutput == swarOutput);
+}
+
+// LZ4 块压缩吞吐和压缩率，数据模拟程序镜像：指令片段重复出现，夹杂常量表和 0xFF 填充
+static void Debug_BenchCompress(uint32_t dataLength) {
+    const int rounds = 10;
+    std::vector<uint8_t> data(dataLength);
+    uint32_t seed = 0x12345678u;
+    for (uint32_t i = 0; i < dataLength;) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t run = 16 + (seed >> 24) % 64;
+        for (uint32_t j = 0; j < run && i < dataLength; ++j, ++i) {
+            switch (seed >> 30) {
+                case 0:
+                    data[i] = 0xFF;
+                    break;
+                case 1:
+                    data[i] = static_cast<uint8_t>(seed >> (j % 4 * 8));
+                    break;
+                default:
+                    data[i] = i >= 256 ? data[i - 256 + (seed >> 16) % 64] : static_cast<uint8_t>(j);
+            }
+        }
+    }
+    std::vector<uint8_t> output;
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        output.clear();
+        lz4FrameHeader(&output);
+        for (uint32_t i = 0; i < dataLength; i += LZ4_BLOCK_MAX_SIZE) {
+            uint32_t length = dataLength - i < LZ4_BLOCK_MAX_SIZE ? dataLength - i : LZ4_BLOCK_MAX_SIZE;
+            lz4AppendBlock(data.data() + i, length, &output);
+        }
+        lz4FrameEnd(&output);
+    }
+    long long elapsed = benchElapsedMicros(begin);
+    double megabytes = static_cast<double>(dataLength) * rounds / 1e6;
+    cclPrintf("Debug_BenchCompress bytes=%u compressed=%zu ratio=%.1f%% speed=%.0fMB/s", dataLength, output.size(),
+              dataLength > 0 ? 100.0 * static_cast<double>(output.size()) / dataLength : 0.0,
+              elapsed > 0 ? megabytes * 1e6 / elapsed : 0.0);
+}
+
+// CRC32 吞吐：逐字节查表、slicing-by-8，以及按 4KB 块交给 IncrementalCrc 在工作线程上计算，单位 MB/s
+static void Debug_BenchCrc32(uint32_t dataLength) {
+    const int rounds = 10;
+    const uint32_t blockLength = 4096;
+    std::vector<uint8_t> data(dataLength);
+    for (uint32_t i = 0; i < dataLength; ++i) {
+        data[i] = static_cast<uint8_t>(i * 131 + (i >> 9));
+    }
+    uint32_t byteCrc = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+//        每轮改动首字节，避免编译器把不变的计算提到循环外
+        data[0] = static_cast<uint8_t>(round);
+        uint32_t crc = 0xFFFFFFFFu;
+        for (uint32_t i = 0; i < dataLength; ++i) {
+            crc = CRC32_TABLE[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+        }
+        byteCrc = crc ^ 0xFFFFFFFFu;
+    }
+    long long byteElapsed = benchElapsedMicros(begin);
+
+    uint32_t sliceCrc = 0;
+    begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        data[0] = static_cast<uint8_t>(round);
+        sliceCrc = crc32(data.data(), dataLength);
+    }
+    long long sliceElapsed = benchElapsedMicros(begin);
+
+    uint32_t incrementalCrc = 0;
+    IncrementalCrc checksum;
+    begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        data[0] = static_cast<uint8_t>(round);
+        checksum.reset();
+        for (uint32_t i = 0; i < dataLength; i += blockLength) {
+            checksum.update(data.data() + i, dataLength - i < blockLength ? dataLength - i : blockLength);
+        }
+        incrementalCrc = checksum.digest();
+    }
+    long long incrementalElapsed = benchElapsedMicros(begin);
+
+    double megabytes = static_cast<double>(dataLength) * rounds / 1e6;
+    auto speed = [megabytes](long long elapsed) { return elapsed > 0 ? megabytes * 1e6 / elapsed : 0.0; };
+    cclPrintf("Debug_BenchCrc32 bytes=%u byte=%.0fMB/s slice8=%.0fMB/s incremental=%.0fMB/s match=%d", dataLength,
+              speed(byteElapsed), speed(sliceElapsed), speed(incrementalElapsed),
+              byteCrc == sliceCrc && sliceCrc == incrementalCrc);
+}
@@ -18,11 +18,20 @@ static void debug() {
 }
 
 static void Debug_SendDiag(uint8_t *data, uint32_t dataLength) {
-    Node *node = new Node();
-    auto *parsingDTO = new DiagSession();
-    parsingDTO->data = data;
-    parsingDTO->dataLength = dataLength;
+//    调试用的默认节点，只创建一次
+    static DiagConfig diagConfig;
+    static Node node;
+    node.diagConfig = &diagConfig;
+    DiagSession *parsingDTO;
+    {
+        std::lock_guard<std::mutex> lock(DiagCompletion::getInstance()->sessionMutex());
+        parsingDTO = SessionTable::getInstance()->acquire();
+    }
+    if (parsingDTO == nullptr) {
+        return;
+    }
+    parsingDTO->assignPayload(data, dataLength);
 
     cclPrintf("dataLength: %d", parsingDTO->dataLength);
-    auto *diagTransmitter = new DiagTransmitter(parsingDTO, node);
+    DiagTransmitter::send(parsingDTO, &node);
 }
\ No newline at end of file